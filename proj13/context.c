@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// Troca de contexto em espaço de usuário para x86-64 e AArch64.
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string.h>
+#include "context.h"
+
+#ifdef CTX_ASM
+
+// Ponto de entrada de um contexto novo: a função e o argumento vêm em
+// registradores preservados, restaurados pelo primeiro ctx_switch.
+void ctx_entry (void) ;
+
+#if defined(__x86_64__)
+
+// Quadro salvo na pilha (do topo para a base): controles de ponto flutuante
+// (mxcsr e palavra de controle x87), r15, r14, r13, r12, rbx, rbp e o
+// endereço de retorno.
+#define CTX_FRAME_WORDS 8
+
+__asm__ (
+    ".text\n"
+    ".globl ctx_switch\n"
+    ".hidden ctx_switch\n"
+    ".type ctx_switch, @function\n"
+    "ctx_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size ctx_switch, .-ctx_switch\n"
+
+    ".globl ctx_entry\n"
+    ".hidden ctx_entry\n"
+    ".type ctx_entry, @function\n"
+    "ctx_entry:\n"
+    "    movq %r13, %rdi\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    ".size ctx_entry, .-ctx_entry\n"
+) ;
+
+void *ctx_init (void *stack, int size, void (*entry)(void *), void *arg)
+{
+   uint64_t *sp ;
+
+   // o topo fica alinhado em 16 bytes, como exige a ABI ao chamar entry
+   sp = (uint64_t *) (((uintptr_t) stack + size) & ~(uintptr_t) 15) ;
+   sp -= CTX_FRAME_WORDS ;
+   memset (sp, 0, CTX_FRAME_WORDS * sizeof (uint64_t)) ;
+
+   sp[0] = 0x1F80 | ((uint64_t) 0x037F << 32) ; // mxcsr e x87 padrão
+   sp[4] = (uint64_t) (uintptr_t) entry ;        // r12
+   sp[3] = (uint64_t) (uintptr_t) arg ;          // r13
+   sp[7] = (uint64_t) (uintptr_t) ctx_entry ;    // endereço de retorno
+
+   return sp ;
+}
+
+#elif defined(__aarch64__)
+
+// Quadro salvo na pilha: x19-x28, x29 (fp), x30 (lr) e d8-d15, totalizando
+// 160 bytes, arredondados para 176 para manter o alinhamento de 16 bytes.
+#define CTX_FRAME_WORDS 22
+
+__asm__ (
+    ".text\n"
+    ".globl ctx_switch\n"
+    ".hidden ctx_switch\n"
+    ".type ctx_switch, %function\n"
+    "ctx_switch:\n"
+    "    sub sp, sp, #176\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8, d9, [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8, d9, [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #176\n"
+    "    ret\n"
+    ".size ctx_switch, .-ctx_switch\n"
+
+    ".globl ctx_entry\n"
+    ".hidden ctx_entry\n"
+    ".type ctx_entry, %function\n"
+    "ctx_entry:\n"
+    "    mov x0, x20\n"
+    "    blr x19\n"
+    "    brk #0\n"
+    ".size ctx_entry, .-ctx_entry\n"
+) ;
+
+void *ctx_init (void *stack, int size, void (*entry)(void *), void *arg)
+{
+   uint64_t *sp ;
+
+   sp = (uint64_t *) (((uintptr_t) stack + size) & ~(uintptr_t) 15) ;
+   sp -= CTX_FRAME_WORDS ;
+   memset (sp, 0, CTX_FRAME_WORDS * sizeof (uint64_t)) ;
+
+   sp[0] = (uint64_t) (uintptr_t) entry ;        // x19
+   sp[1] = (uint64_t) (uintptr_t) arg ;          // x20
+   sp[11] = (uint64_t) (uintptr_t) ctx_entry ;   // x30 (lr)
+
+   return sp ;
+}
+
+#endif
+
+#endif
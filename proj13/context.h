@@ -0,0 +1,34 @@
+//------------------------------------------------------------------------------
+// Troca de contexto em espaço de usuário, sem chamadas de sistema.
+// Alternativa ao swapcontext (que salva e restaura a máscara de sinais a cada
+// troca), usada pelo núcleo quando compilado com -DCTX_ASM.
+//------------------------------------------------------------------------------
+
+#ifndef __CONTEXT__
+#define __CONTEXT__
+
+// Só há implementação para x86-64 e AArch64; nas demais arquiteturas o núcleo
+// continua usando ucontext.
+#if defined(CTX_ASM) && !defined(__x86_64__) && !defined(__aarch64__)
+#undef CTX_ASM
+#endif
+
+#ifdef CTX_ASM
+
+//------------------------------------------------------------------------------
+// Salva os registradores preservados pela ABI (callee-saved) e os controles de
+// ponto flutuante na pilha atual, guarda o topo da pilha em *saveSp e retoma o
+// contexto cuja pilha está em newSp.
+
+void ctx_switch (void **saveSp, void *newSp) ;
+
+//------------------------------------------------------------------------------
+// Prepara a pilha [stack, stack+size) para que o primeiro ctx_switch para ela
+// execute entry(arg). Retorna o topo de pilha a ser passado a ctx_switch.
+// A função entry não pode retornar.
+
+void *ctx_init (void *stack, int size, void (*entry)(void *), void *arg) ;
+
+#endif
+
+#endif
@@ -9,6 +9,20 @@
 
 #include <ucontext.h>
 
+struct core_t;
+struct mutex_t;
+
+#define TASK_NAME_SIZE 16
+#define READ_STREAMS 2 // fluxos de leitura sequencial acompanhados por tarefa
+
+// fluxo de leitura sequencial de uma tarefa, usado na leitura antecipada do disco
+typedef struct {
+	int last; // último bloco lido no fluxo
+	int dir; // sentido do fluxo: 1 crescente, -1 decrescente, 0 ainda não definido
+	int window; // quantos blocos à frente são lidos antecipadamente
+	unsigned int lastUse; // instante da última leitura no fluxo
+} readstream_t ;
+
 // Estrutura que define uma tarefa
 typedef struct task_t {
 	struct task_t* prev;
@@ -18,10 +32,14 @@ typedef struct task_t {
 	struct task_t* main;
 	
 	ucontext_t context;
+	void* sp; // topo da pilha salvo pela troca de contexto em assembly (CTX_ASM)
+	unsigned char preempted; // tarefa retirada do processador pelo tratador de ticks
 
 	char estado;
-	int prio;
+	int prio; // prioridade efetiva: basePrio ou a herdada de quem espera por um mutex seu
+	int basePrio; // prioridade estática definida em task_setprio
 	int dynPrio;
+	unsigned int readyEpoch; // valor de readyEpoch quando entrou na fila de prontas
 
 	unsigned int creationTime;
 	unsigned int lastExecutionTime;
@@ -33,10 +51,40 @@ typedef struct task_t {
 	int exitCode;
 
     unsigned int awakeTime;
+    int sleepIndex; // posição no heap de tarefas dormindo, ou -1
+    unsigned int sleepSeq; // ordem de entrada no heap, desempata tarefas com o mesmo awakeTime
+    unsigned char timedOut; // acordada pelo fim do prazo de uma espera, não pelo evento esperado
+
+	struct core_t* core; // núcleo em cuja fila de prontas a tarefa entrou por último
+	volatile int preemptCount; // aninhamento das seções críticas do núcleo; > 0 impede a preempção
+
+	struct mutex_t* heldMutexes; // mutexes que a tarefa detém (lista por heldNext)
+	struct mutex_t* blockedOn; // mutex pelo qual a tarefa espera, ou NULL
+
+	void (*startFunc)(void*);
+	void* startArg;
+
+	int stackHighWater; // uso máximo da pilha registrado no término da tarefa, ou -1
+
+	readstream_t readStreams[READ_STREAMS];
+
+	int affinity; // núcleo ao qual a tarefa está presa, ou -1 (SMP)
+	unsigned char detached; // não pode ser esperada com task_join
+	unsigned char kernelOwned; // descritor alocado pelo núcleo, liberado no término
+	char name[TASK_NAME_SIZE];
 
 	int tid;
 } task_t ;
 
+// atributos de criação de uma tarefa (task_create_ex)
+typedef struct {
+	int stacksize; // tamanho da pilha em bytes; <= 0 usa o padrão
+	int prio; // prioridade estática inicial
+	int affinity; // núcleo em que a tarefa deve executar (SMP), ou -1 para qualquer um
+	const char* name; // nome para rastreamento, copiado para o descritor
+	unsigned char detached; // libera os recursos no término, sem task_join
+} task_attr_t ;
+
 // estrutura que define um semáforo
 typedef struct {
     struct task_t* queue;
@@ -45,29 +93,75 @@ typedef struct {
     unsigned char active;
 } semaphore_t ;
 
+// tipos de mutex
+#define MUTEX_NORMAL 0 // travar de novo pela dona bloqueia para sempre
+#define MUTEX_RECURSIVE 1 // a dona pode travar de novo; libera após tantos unlocks quantos locks
+#define MUTEX_ERRORCHECK 2 // travar de novo ou destravar sem ser a dona retorna erro
+
 // estrutura que define um mutex
-typedef struct {
+typedef struct mutex_t {
     struct task_t* queue;
     unsigned char value;
+    struct task_t* owner; // tarefa que detém o mutex, ou NULL
+    struct mutex_t* heldNext; // próximo mutex da lista heldMutexes da dona
+    int count; // aninhamento dos locks da dona (MUTEX_RECURSIVE)
+    unsigned char type;
     
     unsigned char active;
 } mutex_t ;
 
+// estrutura que define uma variável de condição
+typedef struct {
+    struct task_t* queue; // tarefas esperando pela condição
+    struct mutex_t* mutex; // mutex usado pelas tarefas que esperam
+
+    unsigned char active;
+} cond_t ;
+
+// leitor de uma trava de leitura/escrita
+typedef struct readhold_t {
+    struct readhold_t* next;
+    struct task_t* task; // tarefa que detém (ou espera) a trava para leitura
+    int count; // leituras obtidas pela tarefa e ainda não liberadas
+} readhold_t ;
+
+// estrutura que define uma trava de leitura/escrita
+typedef struct {
+    struct task_t* readQueue; // leitores esperando
+    struct task_t* writeQueue; // escritores esperando
+    int readers; // leituras concedidas e ainda não liberadas
+    readhold_t* holders; // um registro por tarefa que lê ou espera para ler
+    struct task_t* writer; // escritor com a trava, ou NULL
+
+    unsigned char active;
+} rwlock_t ;
+
 // estrutura que define uma barreira
 typedef struct {
     struct task_t* queue;
     int maxTasks;
     int countTasks;
+    unsigned int generation; // quantas vezes a barreira já foi liberada
     
     unsigned char active;
 } barrier_t ;
 
 // estrutura que define uma fila de mensagens
 typedef struct {
-    void* content;
+    void* content; // maxMessages slots de messageSize bytes, emprestados às tarefas
+    void** ring; // buffer circular com os slots das mensagens enviadas
+    void** freeSlots; // pilha de slots livres
+    unsigned char* slotState; // estado de cada slot: livre, emprestado ou na fila
+    int freeCount;
     int messageSize;
     int maxMessages;
     int countMessages;
+    int head; // posição da mensagem mais antiga em ring (em SPSC, contador módulo 2*maxMessages)
+    int tail; // posição em que a próxima mensagem será colocada em ring (idem)
+
+    unsigned char spsc; // um só produtor e um só consumidor: anel sem trava em content
+    struct task_t* spscWait[2]; // tarefa bloqueada com a fila cheia [0] ou vazia [1]
+    int spscWaiting[2]; // indica que a tarefa acima está prestes a bloquear ou bloqueada
     
     semaphore_t sBuffer;
     semaphore_t sItem;
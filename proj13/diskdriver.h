@@ -10,17 +10,46 @@
 #define DISK_REQUEST_READ 1
 #define DISK_REQUEST_WRITE 0
 
+// políticas de escalonamento dos pedidos ao disco
+#define DISK_SCHED_FCFS 0 // ordem de chegada
+#define DISK_SCHED_SSTF 1 // menor deslocamento a partir da posição atual da cabeça
+#define DISK_SCHED_SCAN 2 // elevador: segue num sentido até o último pedido e então inverte
+#define DISK_SCHED_CSCAN 3 // elevador circular: só no sentido crescente, voltando ao menor bloco
+
+// modos de escrita da cache de blocos
+#define DISK_CACHE_WRITETHROUGH 0 // a escrita espera a gravação no disco
+#define DISK_CACHE_WRITEBACK 1 // a escrita só atualiza a cache; o bloco é gravado depois
+
 // structura de dados que representa um pedido de leitura/escrita ao disco
 typedef struct diskrequest_t {
     struct diskrequest_t* next;
     struct diskrequest_t* prev;
 
-    task_t* task;
+    task_t* task; // tarefa que espera o pedido, ou NULL numa leitura antecipada
     unsigned char operation; // DISK_REQUEST_READ ou DISK_REQUEST_WRITE
     int block;
-    void* buffer;
+    int count; // blocos consecutivos a partir de block
+    void* buffer; // count * blockSize bytes
+    unsigned char done; // operação concluída pelo disco
+    unsigned char failed; // comando recusado pelo disco; o pedido terminou com erro
+    unsigned int arrival; // instante (systime) em que o pedido entrou na fila
+    struct diskrequest_t* batchNext; // próximo pedido atendido no mesmo comando ao disco
 } diskrequest_t;
 
+// entrada da cache de blocos do disco
+typedef struct cacheblock_t {
+    struct cacheblock_t* prev; // lista LRU, da menos para a mais recentemente usada,
+    struct cacheblock_t* next; // ou lista de entradas livres
+    struct cacheblock_t** queue;
+
+    struct cacheblock_t* hashNext; // próxima entrada na mesma posição da tabela de dispersão
+    int block; // bloco guardado, ou -1 se a entrada está livre
+    void* data;
+    unsigned char dirty; // alterado na cache e ainda não gravado no disco
+    unsigned char flushing; // sendo gravado no disco; não pode ser reaproveitado
+    unsigned char prefetched; // lido antecipadamente e ainda não usado
+} cacheblock_t;
+
 // structura de dados que representa o disco para o SO
 typedef struct {
     int numBlocks;
@@ -33,6 +62,38 @@ typedef struct {
 
     task_t* diskQueue;
     diskrequest_t* requestQueue;
+    diskrequest_t* current; // pedidos em atendimento pelo disco (lista por batchNext), ou NULL
+
+    int sched; // política de escalonamento (DISK_SCHED_*)
+    int head; // bloco do último pedido enviado ao disco
+    int direction; // sentido do elevador (SCAN): 1 crescente, -1 decrescente
+
+    long requests; // pedidos atendidos
+    long commands; // comandos enviados ao disco (pedidos vizinhos vão num só comando)
+    long headMovement; // soma dos deslocamentos da cabeça, em blocos
+    long latencyTotal; // soma dos tempos entre a chegada e o fim dos pedidos (ms)
+
+    cacheblock_t* cache; // entradas da cache de blocos
+    cacheblock_t** cacheHash; // tabela de dispersão das entradas em uso, por número de bloco
+    cacheblock_t* cacheLRU; // entradas em uso, da menos para a mais recentemente usada
+    cacheblock_t* cacheFree; // entradas livres
+    void* cacheData; // conteúdo dos blocos, cacheSize * blockSize bytes
+    int cacheSize; // capacidade da cache, em blocos (0 se desativada)
+    long cacheHits;
+    long cacheMisses;
+
+    unsigned char writeback; // modo da cache (DISK_CACHE_WRITEBACK)
+    int dirtyCount; // blocos sujos na cache
+    mutex_t flushLock; // uma gravação dos blocos sujos por vez
+    task_t* flushQueue; // tarefa de gravação esperando trabalho
+    cacheblock_t** flushBatch; // lote de blocos sujos, ordenado por número de bloco
+    void* flushBuffer; // cópia dos blocos sendo gravados
+
+    diskrequest_t* prefetchQueue; // leituras antecipadas, atendidas com o disco ocioso
+    int prefetchCount; // leituras antecipadas na fila ou em andamento
+    task_t* prefetchWait; // tarefas esperando uma leitura antecipada do bloco que pediram
+    long prefetchIssued;
+    long prefetchUsed;
 } disk_t;
 
 // inicializacao do driver de disco
@@ -41,10 +102,56 @@ typedef struct {
 // blockSize: tamanho de cada bloco do disco, em bytes
 int diskdriver_init (int *numBlocks, int *blockSize) ;
 
+// inicialização com a política de escalonamento indicada (DISK_SCHED_*);
+// diskdriver_init atende os pedidos por ordem de chegada (DISK_SCHED_FCFS). O
+// modo de escrita inicial da cache é DISK_CACHE_MODE (write-through, se não
+// definido); em write-back, os blocos sujos são gravados antes do fim do sistema
+int diskdriver_init_sched (int *numBlocks, int *blockSize, int sched) ;
+
 // leitura de um bloco, do disco para o buffer indicado
 int disk_block_read (int block, void *buffer) ;
 
 // escrita de um bloco, do buffer indicado para o disco
 int disk_block_write (int block, void *buffer) ;
 
+// leitura e escrita de count blocos consecutivos a partir de block, de/para um
+// buffer de count * blockSize bytes, num só pedido ao disco para os blocos que
+// não estão na cache. Retornam 0 ou -1 em erro
+int disk_block_readv (int block, int count, void *buffer) ;
+int disk_block_writev (int block, int count, void *buffer) ;
+
+// leitura e escrita com prazo de ms milissegundos: retornam -1 se o pedido
+// ainda estava na fila ao fim do prazo (e foi cancelado); um pedido que o disco
+// já está atendendo não pode ser cancelado, e é esperado até o fim
+int disk_block_read_timed (int block, void *buffer, int ms) ;
+int disk_block_write_timed (int block, void *buffer, int ms) ;
+
+// define a capacidade da cache de blocos do disco, em blocos (0 a desativa);
+// o conteúdo atual da cache é descartado. Retorna 0 ou -1 em erro
+int disk_cache_size (int blocks) ;
+
+// define o modo de escrita da cache (DISK_CACHE_WRITETHROUGH ou
+// DISK_CACHE_WRITEBACK), gravando antes os blocos sujos. Retorna 0 ou -1 em erro
+int disk_cache_mode (int mode) ;
+
+// grava no disco todos os blocos alterados na cache; ao retornar, as escritas
+// feitas antes da chamada estão no disco. Retorna 0 ou -1 em erro
+int disk_sync () ;
+
+// informa quantas leituras foram atendidas pela cache de blocos (hits) e
+// quantas precisaram ir ao disco (misses)
+void disk_cache_stats (long *hits, long *misses) ;
+
+// informa quantos blocos foram lidos antecipadamente (issued) e quantos deles
+// foram depois pedidos por alguma tarefa (used)
+void disk_readahead_stats (long *issued, long *used) ;
+
+// informa quantos pedidos o disco atendeu, o deslocamento total da cabeça (em
+// blocos) e a latência média dos pedidos, da chegada à fila até o fim (em ms)
+void disk_stats (long *requests, long *headMovement, long *avgLatency) ;
+
+// informa quantos comandos foram enviados ao disco; pedidos vizinhos na fila
+// são juntados num só comando, então pode ser menor que o número de pedidos
+void disk_command_stats (long *commands) ;
+
 #endif
@@ -12,6 +12,7 @@
 #include <time.h> 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "harddisk.h"
 
 // operating system check
@@ -33,9 +34,10 @@ typedef struct {
   int fd ;			// descritor do arquivo que simula o disco
   int numblocks ;		// numero de blocos do disco
   int blocksize ;		// tamanho dos blocos em bytes
-  char *buffer ;		// buffer da proxima operacao (read/write)
-  int prev_block ;		// bloco da ultima operacao
-  int next_block ;		// bloco da proxima operacao
+  disk_iovec_t iov[DISK_IOV_MAX] ;	// trechos da proxima operacao (read/write)
+  int iovcnt ;			// numero de trechos da proxima operacao
+  int prev_block ;		// ultimo bloco da ultima operacao
+  int next_block ;		// primeiro bloco da proxima operacao
   int delay_min, delay_max ;	// tempos de acesso mínimo e máximo
   timer_t           timer ;	// timer que simula o tempo de acesso
   struct itimerspec delay ;	// struct do timer de tempo de acesso
@@ -50,6 +52,8 @@ harddisk_t harddisk ;		// hard disk structure
 // trata o sinal SIGIO do timer que simula o tempo de acesso ao disco
 void harddisk_SignalHandle (int sig)
 {
+  int i ;
+
   #ifdef DEBUG_HD
   printf ("Harddisk: signal %d received\n", sig) ;
   #endif
@@ -59,14 +63,20 @@ void harddisk_SignalHandle (int sig)
   {
     case DISK_STATUS_READ:
       // faz a leitura previamente agendada
-      lseek (harddisk.fd, harddisk.next_block * harddisk.blocksize, SEEK_SET) ;
-      read  (harddisk.fd, harddisk.buffer, harddisk.blocksize) ;
+      for (i = 0; i < harddisk.iovcnt; i++)
+      {
+        lseek (harddisk.fd, harddisk.iov[i].block * harddisk.blocksize, SEEK_SET) ;
+        read  (harddisk.fd, harddisk.iov[i].buffer, harddisk.iov[i].count * harddisk.blocksize) ;
+      }
       break ;
 
     case DISK_STATUS_WRITE:
       // faz a escrita previamente agendada
-      lseek (harddisk.fd, harddisk.next_block * harddisk.blocksize, SEEK_SET) ;
-      write (harddisk.fd, harddisk.buffer, harddisk.blocksize) ;
+      for (i = 0; i < harddisk.iovcnt; i++)
+      {
+        lseek (harddisk.fd, harddisk.iov[i].block * harddisk.blocksize, SEEK_SET) ;
+        write (harddisk.fd, harddisk.iov[i].buffer, harddisk.iov[i].count * harddisk.blocksize) ;
+      }
       break ;
 
     default:
@@ -75,8 +85,9 @@ void harddisk_SignalHandle (int sig)
       exit(1); 
   }
 
-  // guarda numero de bloco da ultima operacao
-  harddisk.prev_block = harddisk.next_block ;
+  // guarda numero do ultimo bloco da ultima operacao
+  harddisk.prev_block = harddisk.iov[harddisk.iovcnt - 1].block
+                      + harddisk.iov[harddisk.iovcnt - 1].count - 1 ;
 
   // disco se torna ocioso novamente
   harddisk.status = DISK_STATUS_IDLE ;
@@ -91,19 +102,36 @@ void harddisk_SignalHandle (int sig)
 void harddisk_settimer ()
 {
   int time_ms ;
-
-  // tempo no intervalo [DISK_DELAY_MIN ... DISK_DELAY_MAX], proporcional a
-  // distancia entre o proximo bloco a ler (next_block) e a ultima leitura
-  // (prev_block), somado a um pequeno fator aleatorio
-  time_ms = abs (harddisk.next_block - harddisk.prev_block)
-          * (harddisk.delay_max - harddisk.delay_min) / harddisk.numblocks
-          + harddisk.delay_min
-          + random () % (harddisk.delay_max - harddisk.delay_min) / 10 ;
+  int blocks ;
+  int pos ;
+  int i ;
+
+  // para cada sequencia de blocos contiguos, tempo no intervalo
+  // [DISK_DELAY_MIN ... DISK_DELAY_MAX], proporcional a distancia entre o
+  // primeiro bloco da sequencia e o bloco anterior (prev_block, na primeira),
+  // somado a um pequeno fator aleatorio; cada bloco a mais numa sequencia custa
+  // o tempo de deslocamento por um bloco
+  time_ms = 0 ;
+  blocks = 0 ;
+  pos = harddisk.prev_block ;
+  for (i = 0; i < harddisk.iovcnt; i++)
+  {
+    if (i == 0 || harddisk.iov[i].block != pos + 1)
+      time_ms += abs (harddisk.iov[i].block - pos)
+               * (harddisk.delay_max - harddisk.delay_min) / harddisk.numblocks
+               + harddisk.delay_min
+               + random () % (harddisk.delay_max - harddisk.delay_min) / 10 ;
+    else
+      blocks++ ;
+    blocks += harddisk.iov[i].count - 1 ;
+    pos = harddisk.iov[i].block + harddisk.iov[i].count - 1 ;
+  }
+  time_ms += blocks * (harddisk.delay_max - harddisk.delay_min) / harddisk.numblocks ;
 
   // printf ("\n[%d->%d, %d]\n", harddisk.prev_block, harddisk.next_block, time_ms) ;   
 
-  // primeiro disparo, em nano-segundos,
-  harddisk.delay.it_value.tv_nsec = time_ms * 1000000 ;
+  // primeiro disparo, em nano-segundos (a parte abaixo de um segundo)
+  harddisk.delay.it_value.tv_nsec = (time_ms % 1000) * 1000000 ;
 
   // primeiro disparo, em segundos
   harddisk.delay.it_value.tv_sec  = time_ms / 1000 ;
@@ -180,6 +208,9 @@ int harddisk_init ()
 // funcao que implementa a interface de acesso ao disco em baixo nivel
 int disk_cmd (int cmd, int block, void *buffer)
 {
+  disk_iovec_t *iov ;
+  int i ;
+
   #ifdef DEBUG_HD
   printf ("Harddisk: received command %d\n", cmd) ;
   #endif
@@ -222,7 +253,10 @@ int disk_cmd (int cmd, int block, void *buffer)
         return -1 ;
 
       // registrar que ha uma operacao pendente
-      harddisk.buffer = buffer ;
+      harddisk.iov[0].block = block ;
+      harddisk.iov[0].count = 1 ;
+      harddisk.iov[0].buffer = buffer ;
+      harddisk.iovcnt = 1 ;
       harddisk.next_block = block ;
       if (cmd == DISK_CMD_READ)
         harddisk.status = DISK_STATUS_READ ;
@@ -234,6 +268,33 @@ int disk_cmd (int cmd, int block, void *buffer)
 
       return 0 ;
 
+    case DISK_CMD_READV:
+    case DISK_CMD_WRITEV:
+      // aqui, block eh o numero de trechos e buffer o vetor de trechos
+      if ( harddisk.status != DISK_STATUS_IDLE)
+        return -1 ;
+      iov = buffer ;
+      if ( !iov || block < 1 || block > DISK_IOV_MAX)
+        return -1 ;
+      for (i = 0; i < block; i++)
+        if ( !iov[i].buffer || iov[i].count < 1 || iov[i].block < 0
+             || iov[i].block + iov[i].count > harddisk.numblocks)
+          return -1 ;
+
+      // registrar que ha uma operacao pendente (o vetor de trechos eh copiado)
+      memcpy (harddisk.iov, iov, block * sizeof (disk_iovec_t)) ;
+      harddisk.iovcnt = block ;
+      harddisk.next_block = iov[0].block ;
+      if (cmd == DISK_CMD_READV)
+        harddisk.status = DISK_STATUS_READ ;
+      else
+        harddisk.status = DISK_STATUS_WRITE ;
+
+      // armar o timer para gerar SIGIO
+      harddisk_settimer () ;
+
+      return 0 ;
+
     default:
       return -1 ;
   }
@@ -19,6 +19,18 @@
 #define DISK_CMD_BLOCKSIZE	5	// consulta tamanho de bloco em bytes
 #define DISK_CMD_DELAYMIN	6	// consulta tempo resposta mínimo (ms)
 #define DISK_CMD_DELAYMAX	7	// consulta tempo resposta máximo (ms)
+#define DISK_CMD_READV		8	// leitura vetorial de trechos de blocos
+#define DISK_CMD_WRITEV		9	// escrita vetorial de trechos de blocos
+
+#define DISK_IOV_MAX		16	// numero maximo de trechos num comando vetorial
+
+// trecho de uma operacao vetorial: count blocos consecutivos a partir de block,
+// de/para um buffer de count * tamanho de bloco bytes
+typedef struct {
+  int block ;
+  int count ;
+  void *buffer ;
+} disk_iovec_t ;
 
 // estados internos do disco
 #define DISK_STATUS_UNKNOWN	0	// disco não inicializado
@@ -50,6 +62,14 @@ int disk_cmd (int cmd, int block, void *buffer) ;
 // result < 0: erro
 // result = 0: ok (escrita agendada, sinal SIGUSR1 serah gerado ao completar)
 //
+// agenda a leitura (ou escrita) de iovcnt trechos de blocos (operacao
+// assincrona); o tempo de posicionamento da cabeca eh pago uma vez por sequencia
+// de blocos contiguos, e cada bloco a mais custa so o tempo de transferencia
+// int disk_cmd (DISK_CMD_READV, int iovcnt, disk_iovec_t *iov) ;
+// int disk_cmd (DISK_CMD_WRITEV, int iovcnt, disk_iovec_t *iov) ;
+// result < 0: erro
+// result = 0: ok (operacao agendada, sinal SIGUSR1 serah gerado ao completar)
+//
 // consulta status do disco (operacao sincrona)
 // int disk_cmd (DISK_CMD_STATUS, 0, 0) ;
 // result < 0: erro
@@ -0,0 +1,117 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste de task_create_ex: atributos inválidos (prioridade fora da faixa,
+// núcleo inexistente, tarefa não desvinculada sem descritor) devem ser
+// recusados sem criar a tarefa; os aceitos devem valer na tarefa criada. Uma
+// tarefa desvinculada sem descritor deve executar, e não pode ser esperada.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+
+task_t tarefa, desvinculada ;
+volatile int executou = 0, desvinculadas = 0 ;
+int prioVista ;
+char nomeVisto[32] ;
+
+void tarefaBody (void * arg)
+{
+   prioVista = task_getprio (NULL) ;
+   strcpy (nomeVisto, task_getname (NULL)) ;
+   executou++ ;
+   task_exit (7) ;
+}
+
+void desvinculadaBody (void * arg)
+{
+   desvinculadas++ ;
+   task_exit (0) ;
+}
+
+// tenta criar uma tarefa com os atributos, que devem ser recusados
+int recusa (const char *motivo, task_t *task, const task_attr_t *attr)
+{
+   if (task_create_ex (task, tarefaBody, NULL, attr) < 0)
+      return 0 ;
+   printf ("Tarefa criada com %s!\n", motivo) ;
+   return 1 ;
+}
+
+int main (int argc, char *argv[])
+{
+   task_attr_t attr ;
+   int erros = 0, i ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   task_attr_init (&attr) ;
+   attr.prio = 21 ;
+   erros += recusa ("prioridade 21", &tarefa, &attr) ;
+   attr.prio = -21 ;
+   erros += recusa ("prioridade -21", &tarefa, &attr) ;
+
+   task_attr_init (&attr) ;
+   attr.affinity = -2 ;
+   erros += recusa ("afinidade -2", &tarefa, &attr) ;
+   attr.affinity = 64 ;
+   erros += recusa ("afinidade 64", &tarefa, &attr) ;
+
+   task_attr_init (&attr) ;
+   erros += recusa ("descritor NULL sem detached", NULL, &attr) ;
+
+   // nenhuma das recusadas pode ter executado
+   task_yield () ;
+   if (executou != 0)
+      erros++ ;
+
+   // atributos aceitos, com nome maior que o descritor comporta
+   task_attr_init (&attr) ;
+   attr.prio = -7 ;
+   attr.affinity = 0 ;
+   attr.stacksize = 64 * 1024 ;
+   attr.name = "uma-tarefa-de-nome-comprido" ;
+   if (task_create_ex (&tarefa, tarefaBody, NULL, &attr) < 0)
+      erros++ ;
+   else
+   {
+      if (task_getprio (&tarefa) != -7 || strcmp (task_getname (&tarefa), "uma-tarefa-de-n") != 0)
+         erros++ ;
+      if (task_join (&tarefa) != 7 || executou != 1)
+         erros++ ;
+      printf ("Tarefa \"%s\" executou com prioridade %d\n", nomeVisto, prioVista) ;
+      if (prioVista != -7 || strcmp (nomeVisto, "uma-tarefa-de-n") != 0)
+         erros++ ;
+   }
+
+   // sem atributos, valem os padrão
+   if (task_create_ex (&tarefa, tarefaBody, NULL, NULL) < 0 || task_join (&tarefa) != 7)
+      erros++ ;
+   if (prioVista != 0 || nomeVisto[0] != '\0')
+      erros++ ;
+
+   // desvinculadas: com descritor (não pode ser esperada) e sem descritor
+   task_attr_init (&attr) ;
+   attr.detached = 1 ;
+   if (task_create_ex (&desvinculada, desvinculadaBody, NULL, &attr) < 0)
+      erros++ ;
+   else if (task_join (&desvinculada) != -1)
+      erros++ ;
+   for (i = 0; i < 5; i++)
+      if (task_create_ex (NULL, desvinculadaBody, NULL, &attr) < 0)
+         erros++ ;
+   while (desvinculadas < 6)
+      task_yield () ;
+
+   if (erros == 0)
+      printf ("Atributos de tarefa conferidos, resultado correto!\n") ;
+   else
+      printf ("%d erros nos atributos de tarefa!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
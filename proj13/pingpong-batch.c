@@ -0,0 +1,112 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste do envio e recebimento em lote: o produtor manda lotes maiores que a
+// capacidade da fila com mqueue_send_n e o consumidor os recebe em lotes
+// menores com mqueue_recv_n, conferindo a ordem e a soma dos valores. Um
+// envio interrompido pela destruição da fila deve informar quantas mensagens
+// chegaram a ser enfileiradas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMMSGS   100000
+#define SENDBATCH 300
+#define RECVBATCH 64
+#define QUEUESIZE 50
+
+task_t prod, cons, parcial ;
+mqueue_t fila ;
+long int soma = 0 ;
+int foraDeOrdem = 0, enviadas ;
+
+void prodBody (void * arg)
+{
+   int valores[SENDBATCH] ;
+   int i = 0, k ;
+
+   while (i < NUMMSGS)
+   {
+      for (k = 0; k < SENDBATCH && i < NUMMSGS; k++, i++)
+         valores[k] = i ;
+      mqueue_send_n (&fila, valores, k) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   int valores[RECVBATCH] ;
+   int recebidas = 0, ultimo = -1, j, k ;
+
+   while (recebidas < NUMMSGS)
+   {
+      k = mqueue_recv_n (&fila, valores, RECVBATCH) ;
+      if (k <= 0)
+         break ;
+      for (j = 0; j < k; j++)
+      {
+         if (valores[j] != ultimo + 1)
+            foraDeOrdem++ ;
+         ultimo = valores[j] ;
+         soma += valores[j] ;
+      }
+      recebidas += k ;
+   }
+   task_exit (0) ;
+}
+
+// envia um lote maior que a fila, sem consumidor
+void parcialBody (void * arg)
+{
+   int valores[2 * QUEUESIZE] = { 0 } ;
+
+   enviadas = mqueue_send_n (&fila, valores, 2 * QUEUESIZE) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long int esperado = (long) NUMMSGS * (NUMMSGS - 1) / 2 ;
+   int vazio, valor ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mqueue_create (&fila, QUEUESIZE, sizeof(int)) ;
+
+   printf ("%d mensagens em lotes de %d, recebidas em lotes de %d\n",
+           NUMMSGS, SENDBATCH, RECVBATCH) ;
+
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   if (soma == esperado && foraDeOrdem == 0)
+      printf ("Soma deu %ld, valor correto!\n", soma) ;
+   else
+      printf ("Soma deu %ld, mas deveria ser %ld (%d fora de ordem)!\n",
+              soma, esperado, foraDeOrdem) ;
+
+   // lotes vazios transferem zero mensagens nos dois sentidos
+   vazio = mqueue_send_n (&fila, &valor, 0) + mqueue_recv_n (&fila, &valor, 0) ;
+
+   // a fila é destruída com o envio parado no meio
+   task_create (&parcial, parcialBody, NULL) ;
+   task_sleep_ms (10) ;
+   mqueue_destroy (&fila) ;
+   task_join (&parcial) ;
+
+   if (vazio == 0 && enviadas == QUEUESIZE)
+      printf ("Envio interrompido informou %d mensagens, valor correto!\n", enviadas) ;
+   else
+      printf ("Envio interrompido informou %d mensagens, mas deveria ser %d (lotes vazios: %d)!\n",
+              enviadas, QUEUESIZE, vazio) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
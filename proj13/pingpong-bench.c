@@ -0,0 +1,49 @@
+// PingPongOS - PingPong Operating System
+//
+// Microbenchmark de troca de contexto: duas tarefas cedem o processador uma
+// para a outra repetidamente; cada task_yield passa o processador à outra
+// tarefa.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pingpong.h"
+
+#define YIELDS 1000000
+
+task_t Ping, Pong ;
+
+void Body (void * arg)
+{
+   int i ;
+
+   for (i = 0; i < YIELDS; i++)
+      task_yield () ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   struct timespec start, end ;
+   double elapsed ;
+   long yields ;
+
+   pingpong_init () ;
+
+   clock_gettime (CLOCK_MONOTONIC, &start) ;
+
+   task_create (&Ping, Body, NULL) ;
+   task_create (&Pong, Body, NULL) ;
+   task_join (&Ping) ;
+   task_join (&Pong) ;
+
+   clock_gettime (CLOCK_MONOTONIC, &end) ;
+
+   elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9 ;
+   yields = 2L * YIELDS ;
+   printf ("%ld task_yield em %.3f s: %.0f trocas/s (%.1f ns por troca)\n",
+           yields, elapsed, yields / elapsed, elapsed * 1e9 / yields) ;
+
+   task_exit (0) ;
+   exit (0) ;
+}
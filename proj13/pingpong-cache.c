@@ -0,0 +1,124 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da cache de blocos do disco, em modo write-through: tarefas escrevem
+// e releem blocos em áreas disjuntas do disco, conferindo o conteúdo lido da
+// cache e depois o gravado no disco, com a cache desativada. Os blocos usados
+// são restaurados no fim.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+#include "diskdriver.h"
+
+#define NUMTASKS  4
+#define NUMBLOCKS 8		// blocos de cada tarefa
+#define NUMROUNDS 3
+#define CACHESIZE 16
+#define NUMHITS   1000
+
+task_t tarefa[NUMTASKS] ;
+int numBlocks ;			// numero de blocos no disco
+int blockSize ;			// tamanho de cada bloco (bytes)
+char esperado[NUMTASKS * NUMBLOCKS] ;	// conteudo esperado de cada bloco
+int erros = 0 ;
+
+void tarefaBody (void * arg)
+{
+   long myNumber = (long) arg ;
+   char *buffer, *lido ;
+   int r, k, block ;
+
+   buffer = malloc (blockSize) ;
+   lido = malloc (blockSize) ;
+
+   for (r = 0; r < NUMROUNDS; r++)
+   {
+      // escreve e relê cada bloco da tarefa
+      for (k = 0; k < NUMBLOCKS; k++)
+      {
+         block = myNumber * NUMBLOCKS + k ;
+         memset (buffer, 'A' + (block + r) % 26, blockSize) ;
+         if (disk_block_write (block, buffer) < 0)
+            erros++ ;
+         esperado[block] = buffer[0] ;
+         if (disk_block_read (block, lido) < 0 || memcmp (buffer, lido, blockSize))
+            erros++ ;
+      }
+
+      // relê os blocos em outra ordem; todos devem estar na cache
+      for (k = 0; k < NUMBLOCKS; k++)
+      {
+         block = myNumber * NUMBLOCKS + (k * 5) % NUMBLOCKS ;
+         if (disk_block_read (block, lido) < 0 || lido[0] != esperado[block])
+            erros++ ;
+      }
+   }
+   free (buffer) ;
+   free (lido) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   char *original, *buffer ;
+   long i, hits, misses ;
+   unsigned int inicio, tempo ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   if (diskdriver_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   disk_cache_mode (DISK_CACHE_WRITETHROUGH) ;
+   disk_cache_size (CACHESIZE) ;
+
+   // guarda o conteúdo original dos blocos usados
+   original = malloc (NUMTASKS * NUMBLOCKS * blockSize) ;
+   buffer = malloc (blockSize) ;
+   disk_block_readv (0, NUMTASKS * NUMBLOCKS, original) ;
+
+   for (i = 0; i < NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, (void *) i) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   // leituras repetidas do mesmo bloco não vão ao disco; a primeira pode ir
+   disk_block_read (NUMTASKS * NUMBLOCKS - 1, buffer) ;
+   inicio = systime () ;
+   for (i = 0; i < NUMHITS; i++)
+      disk_block_read (NUMTASKS * NUMBLOCKS - 1, buffer) ;
+   tempo = systime () - inicio ;
+
+   if (disk_block_read (-1, buffer) != -1 || disk_block_read (numBlocks, buffer) != -1)
+      erros++ ;
+
+   disk_cache_stats (&hits, &misses) ;
+
+   // sem a cache, o conteúdo vem do disco
+   disk_cache_size (0) ;
+   for (i = 0; i < NUMTASKS * NUMBLOCKS; i++)
+      if (disk_block_read (i, buffer) < 0 || buffer[0] != esperado[i])
+         erros++ ;
+
+   // restaura o conteúdo original
+   disk_block_writev (0, NUMTASKS * NUMBLOCKS, original) ;
+   free (original) ;
+   free (buffer) ;
+
+   if (erros == 0 && hits >= NUMHITS && tempo < 50)
+      printf ("%ld acertos e %ld faltas na cache, conteudo correto!\n", hits, misses) ;
+   else
+      printf ("%d erros, %ld acertos e %ld faltas, %d leituras em %u ms!\n",
+              erros, hits, misses, NUMHITS, tempo) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
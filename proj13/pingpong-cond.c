@@ -0,0 +1,136 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste das variáveis de condição: produtores e consumidores trocam itens
+// por um buffer limitado protegido por um mutex, esperando com cond_wait
+// enquanto o buffer está cheio ou vazio; depois, um cond_broadcast deve
+// acordar todas as tarefas que esperam.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMPROD    3
+#define NUMCONS    3
+#define NUMITEMS   3000
+#define BUFSIZE    4
+#define NUMWAITERS 5
+
+task_t prod[NUMPROD], cons[NUMCONS], espera[NUMWAITERS] ;
+mutex_t m ;
+cond_t cheio, vazio, sinal ;
+int buffer[BUFSIZE], itens = 0, entrada = 0, saida = 0 ;
+int consumidos = 0, acordadas = 0, liberado = 0 ;
+long int soma = 0 ;
+
+void prodBody (void * arg)
+{
+   int i ;
+
+   for (i = 1; i <= NUMITEMS; i++)
+   {
+      mutex_lock (&m) ;
+      while (itens == BUFSIZE)
+         cond_wait (&cheio, &m) ;
+      buffer[entrada] = i ;
+      entrada = (entrada + 1) % BUFSIZE ;
+      itens++ ;
+      cond_signal (&vazio) ;
+      mutex_unlock (&m) ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   while (1)
+   {
+      mutex_lock (&m) ;
+      while (itens == 0 && consumidos < NUMPROD * NUMITEMS)
+         cond_wait (&vazio, &m) ;
+      if (consumidos == NUMPROD * NUMITEMS)
+      {
+         mutex_unlock (&m) ;
+         break ;
+      }
+      soma += buffer[saida] ;
+      saida = (saida + 1) % BUFSIZE ;
+      itens-- ;
+      consumidos++ ;
+
+      // o último item libera os consumidores que ainda esperam
+      if (consumidos == NUMPROD * NUMITEMS)
+         cond_broadcast (&vazio) ;
+      cond_signal (&cheio) ;
+      mutex_unlock (&m) ;
+   }
+   task_exit (0) ;
+}
+
+void esperaBody (void * arg)
+{
+   mutex_lock (&m) ;
+   while (!liberado)
+      cond_wait (&sinal, &m) ;
+   acordadas++ ;
+   mutex_unlock (&m) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long int esperado = (long) NUMPROD * NUMITEMS * (NUMITEMS + 1) / 2 ;
+   int i, semDona ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mutex_create (&m) ;
+   cond_create (&cheio) ;
+   cond_create (&vazio) ;
+   cond_create (&sinal) ;
+
+   for (i = 0; i < NUMPROD; i++)
+      task_create (&prod[i], prodBody, NULL) ;
+   for (i = 0; i < NUMCONS; i++)
+      task_create (&cons[i], consBody, NULL) ;
+   for (i = 0; i < NUMPROD; i++)
+      task_join (&prod[i]) ;
+   for (i = 0; i < NUMCONS; i++)
+      task_join (&cons[i]) ;
+
+   if (soma == esperado)
+      printf ("Soma deu %ld, valor correto!\n", soma) ;
+   else
+      printf ("Soma deu %ld, mas deveria ser %ld!\n", soma, esperado) ;
+
+   // todas as tarefas esperando devem acordar com um só cond_broadcast
+   for (i = 0; i < NUMWAITERS; i++)
+      task_create (&espera[i], esperaBody, NULL) ;
+   task_sleep_ms (20) ;
+   mutex_lock (&m) ;
+   liberado = 1 ;
+   cond_broadcast (&sinal) ;
+   mutex_unlock (&m) ;
+   for (i = 0; i < NUMWAITERS; i++)
+      task_join (&espera[i]) ;
+
+   // esperar sem deter o mutex deve ser recusado
+   semDona = cond_wait (&sinal, &m) ;
+
+   if (acordadas == NUMWAITERS && semDona == -1)
+      printf ("Broadcast acordou %d tarefas, valor correto!\n", acordadas) ;
+   else
+      printf ("Broadcast acordou %d tarefas, mas deveria ser %d (cond_wait sem o mutex: %d)!\n",
+              acordadas, NUMWAITERS, semDona) ;
+
+   cond_destroy (&cheio) ;
+   cond_destroy (&vazio) ;
+   cond_destroy (&sinal) ;
+   mutex_destroy (&m) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,77 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da troca direta em task_yield: tarefas de mesma prioridade que cedem
+// o processador devem se alternar em rodízio, e uma tarefa que cede o
+// processador sozinha deve continuar executando, sem trocas de contexto.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMTASKS  3
+#define NUMROUNDS 100
+#define NUMYIELDS 1000
+
+task_t tarefa[NUMTASKS], sozinha ;
+char ordem[NUMTASKS * NUMROUNDS + 1] ;
+int executadas = 0 ;
+
+// registra sua letra a cada vez que executa
+void tarefaBody (void * arg)
+{
+   int i ;
+
+   for (i = 0; i < NUMROUNDS; i++)
+   {
+      ordem[executadas++] = 'A' + (long) arg ;
+      task_yield () ;
+   }
+   task_exit (0) ;
+}
+
+void sozinhaBody (void * arg)
+{
+   int i ;
+
+   for (i = 0; i < NUMYIELDS; i++)
+      task_yield () ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long i ;
+   int erros = 0 ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   for (i = 0; i < NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, (void *) i) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   printf ("Ordem: %.12s...\n", ordem) ;
+   for (i = 0; i < NUMTASKS * NUMROUNDS; i++)
+      if (ordem[i] != 'A' + i % NUMTASKS)
+         erros++ ;
+
+   // com a main esperando, a tarefa é a única pronta
+   task_create (&sozinha, sozinhaBody, NULL) ;
+   task_join (&sozinha) ;
+
+   printf ("Tarefa sozinha: %d ativacoes em %d yields\n", sozinha.activations, NUMYIELDS) ;
+   if (sozinha.activations >= 10)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Troca direta conferida, resultado correto!\n") ;
+   else
+      printf ("%d erros na troca direta!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,67 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste do dispatcher ocioso: enquanto todas as tarefas dormem, o processo
+// deve ficar bloqueado esperando o próximo sinal, e não consumir o processador
+// em espera ativa. As tarefas ainda devem acordar no prazo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pingpong.h"
+
+#define NUMTASKS 4
+#define SLEEPMS  100
+#define ROUNDS   3
+
+task_t tarefa[NUMTASKS] ;
+int atrasoMax = 0 ;
+
+// dorme algumas vezes, registrando o maior atraso ao acordar
+void tarefaBody (void * arg)
+{
+   unsigned int inicio ;
+   int i, atraso ;
+
+   for (i = 0; i < ROUNDS; i++)
+   {
+      inicio = systime () ;
+      task_sleep_ms (SLEEPMS + (long) arg) ;
+      atraso = systime () - inicio - (SLEEPMS + (long) arg) ;
+      if (atraso > atrasoMax)
+         atrasoMax = atraso ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long i ;
+   unsigned int inicio, tempo ;
+   clock_t cpu ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   inicio = systime () ;
+   cpu = clock () ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, (void *) (i * 10)) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+   cpu = (clock () - cpu) * 1000 / CLOCKS_PER_SEC ;
+   tempo = systime () - inicio ;
+
+   printf ("%u ms de espera, %ld ms de processador, atraso maximo de %d ms\n",
+           tempo, (long) cpu, atrasoMax) ;
+
+   if (cpu < tempo / 4 && atrasoMax < 20)
+      printf ("Dispatcher ocioso sem espera ativa, resultado correto!\n") ;
+   else
+      printf ("Dispatcher consumiu %ld de %u ms ou atrasou %d ms!\n", (long) cpu, tempo, atrasoMax) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,104 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste das pilhas mapeadas sob demanda (compilar com STACK_MMAP): o uso máximo
+// da pilha de uma tarefa deve acompanhar o quanto ela de fato usou, também
+// quando a pilha veio do pool, e muitas tarefas com pilhas grandes devem
+// poder existir ao mesmo tempo. Sem STACK_MMAP, o uso máximo não é
+// conhecido e task_stack_highwater deve retornar -1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+
+#define BIGSTACK  (1024 * 1024)
+#define DEEPUSE   (256 * 1024)	// quanto a tarefa funda usa da pilha
+#define LIGHTUSE  (32 * 1024)	// limite de uso aceito para a tarefa leve
+#define NUMTASKS  200
+
+task_t funda, leve, tarefa[NUMTASKS] ;
+int soma = 0, hwPropria ;
+
+// desce recursivamente até usar cerca de bytes da pilha
+int desce (int bytes)
+{
+   char buffer[4096] ;
+
+   memset (buffer, 1, sizeof (buffer)) ;
+   if (bytes <= (int) sizeof (buffer))
+      return buffer[0] ;
+   return buffer[sizeof (buffer) - 1] + desce (bytes - sizeof (buffer)) ;
+}
+
+void fundaBody (void * arg)
+{
+   soma += desce (DEEPUSE) ;
+   task_exit (0) ;
+}
+
+// consulta o próprio uso da pilha, ainda em execução
+void leveBody (void * arg)
+{
+   hwPropria = task_stack_highwater (NULL) ;
+   soma++ ;
+   task_exit (0) ;
+}
+
+// tarefas que existem todas ao mesmo tempo: só executam depois de criadas
+void tarefaBody (void * arg)
+{
+   task_yield () ;
+   soma++ ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int erros = 0, hwFunda, hwLeve, i ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   // a leve recebe do pool a pilha que a funda usou
+   task_create_stack (&funda, fundaBody, NULL, BIGSTACK) ;
+   task_join (&funda) ;
+   task_create_stack (&leve, leveBody, NULL, BIGSTACK) ;
+   task_join (&leve) ;
+
+   hwFunda = task_stack_highwater (&funda) ;
+   hwLeve = task_stack_highwater (&leve) ;
+   printf ("Uso maximo da pilha: funda %d bytes, leve %d bytes\n", hwFunda, hwLeve) ;
+
+#ifdef STACK_MMAP
+   if (hwFunda < DEEPUSE || hwFunda > BIGSTACK)
+      erros++ ;
+   if (hwLeve <= 0 || hwLeve > LIGHTUSE)
+      erros++ ;
+   if (hwPropria <= 0 || hwPropria > hwLeve)
+      erros++ ;
+#else
+   if (hwFunda != -1 || hwLeve != -1 || hwPropria != -1)
+      erros++ ;
+#endif
+
+   // muitas pilhas grandes ao mesmo tempo
+   for (i = 0; i < NUMTASKS; i++)
+      if (task_create_stack (&tarefa[i], tarefaBody, NULL, BIGSTACK) < 0)
+         erros++ ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   if (soma != desce (DEEPUSE) + 1 + NUMTASKS)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Pilhas conferidas, resultado correto!\n") ;
+   else
+      printf ("%d erros nas pilhas!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
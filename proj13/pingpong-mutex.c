@@ -0,0 +1,139 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste dos tipos de mutex: a dona de um mutex recursivo pode travá-lo de novo,
+// e as outras tarefas só o obtêm depois de tantos unlocks quantos locks; um
+// mutex com verificação de erros recusa o novo lock da dona e o unlock de quem
+// não é a dona. O campo owner deve indicar sempre a dona, inclusive quando o
+// mutex é passado direto para uma tarefa que esperava por ele.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMLOCKS 3
+
+task_t dona, outra ;
+mutex_t m ;
+int erros = 0, obteve = 0 ;
+
+// trava o mutex recursivo várias vezes e o libera aos poucos, dando a vez à
+// outra tarefa a cada passo
+void donaBody (void * arg)
+{
+   int i ;
+
+   for (i = 0; i < NUMLOCKS; i++)
+      if (mutex_lock (&m) < 0)
+         erros++ ;
+   if (m.owner != &dona)
+      erros++ ;
+   task_yield () ;
+
+   for (i = 0; i < NUMLOCKS; i++)
+   {
+      if (obteve || m.owner != &dona)
+         erros++ ;
+      if (mutex_unlock (&m) < 0)
+         erros++ ;
+      if (i < NUMLOCKS - 1)
+         task_yield () ;
+   }
+
+   // o mutex passou para a outra (que só executa agora, salvo preempção)
+   if ((m.owner != &outra && !obteve) || mutex_unlock (&m) != -1)
+      erros++ ;
+   task_exit (0) ;
+}
+
+// tenta obter o mutex, e depois espera por ele
+void outraBody (void * arg)
+{
+   if (mutex_lock_try (&m) != -1 || mutex_unlock (&m) != -1)
+      erros++ ;
+   if (mutex_lock (&m) < 0 || m.owner != &outra)
+      erros++ ;
+   obteve = 1 ;
+   mutex_unlock (&m) ;
+   task_exit (0) ;
+}
+
+// tenta liberar um mutex de outra tarefa
+void intrusaBody (void * arg)
+{
+   if (mutex_unlock (&m) != -1)
+      erros++ ;
+   task_exit (0) ;
+}
+
+// trava e libera o mutex conferindo a dona; no de verificação de erros,
+// confere também as operações recusadas
+void verificaBody (void * arg)
+{
+   if (mutex_lock (&m) < 0 || m.owner != &dona)
+      erros++ ;
+   if (m.type == MUTEX_ERRORCHECK)
+   {
+      if (mutex_lock (&m) != -1 || mutex_lock_timed (&m, 10) != -1)
+         erros++ ;
+      task_create (&outra, intrusaBody, NULL) ;
+      task_join (&outra) ;
+   }
+   if (m.owner != &dona || mutex_unlock (&m) < 0)
+      erros++ ;
+   if (m.owner != NULL)
+      erros++ ;
+   if (m.type == MUTEX_ERRORCHECK && mutex_unlock (&m) != -1)
+      erros++ ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int antes ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   if (mutex_create_type (&m, 3) != -1)
+      erros++ ;
+
+   // recursivo
+   mutex_create_type (&m, MUTEX_RECURSIVE) ;
+   task_create (&dona, donaBody, NULL) ;
+   task_create (&outra, outraBody, NULL) ;
+   task_join (&dona) ;
+   task_join (&outra) ;
+   if (!obteve || m.owner != NULL)
+      erros++ ;
+   mutex_destroy (&m) ;
+   printf ("Mutex recursivo: %d erros\n", erros) ;
+
+   // com verificação de erros
+   antes = erros ;
+   mutex_create_type (&m, MUTEX_ERRORCHECK) ;
+   task_create (&dona, verificaBody, NULL) ;
+   task_join (&dona) ;
+   mutex_destroy (&m) ;
+   printf ("Mutex com verificacao de erros: %d erros\n", erros - antes) ;
+
+   // normal: owner também é mantido
+   antes = erros ;
+   mutex_create (&m) ;
+   if (m.type != MUTEX_NORMAL)
+      erros++ ;
+   task_create (&dona, verificaBody, NULL) ;
+   task_join (&dona) ;
+   mutex_destroy (&m) ;
+   printf ("Mutex normal: %d erros\n", erros - antes) ;
+
+   if (erros == 0)
+      printf ("Tipos de mutex conferidos, resultado correto!\n") ;
+   else
+      printf ("%d erros nos tipos de mutex!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
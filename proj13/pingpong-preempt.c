@@ -0,0 +1,105 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da preempção: tarefas que ocupam o processador sem nunca ceder devem
+// se alternar pelos ticks do relógio. Depois, tarefas que usam um mutex e um
+// semáforo o tempo todo recebem muitos ticks dentro das seções críticas do
+// núcleo, que só podem trocar de tarefa na saída delas: nenhuma operação pode
+// se perder, e fora do núcleo a preempção não pode ficar desligada.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMTASKS 3
+#define RUNMS    300	// duração de cada fase
+
+task_t tarefa[NUMTASKS] ;
+mutex_t m ;
+semaphore_t s ;
+long soma = 0, somaSem = 0, operacoes[NUMTASKS] ;
+int trocas[NUMTASKS], ultima = -1, erros = 0 ;
+unsigned int fim ;
+
+// só ocupa o processador até o fim da fase, contando as vezes em que voltou a
+// executar depois de outra tarefa
+void calculaBody (void * arg)
+{
+   long id = (long) arg ;
+
+   while (systime () < fim)
+      if (ultima != id)
+      {
+         ultima = id ;
+         trocas[id]++ ;
+      }
+   task_exit (0) ;
+}
+
+// usa o mutex e o semáforo sem parar até o fim da fase
+void sincronizaBody (void * arg)
+{
+   long id = (long) arg ;
+
+   while (systime () < fim)
+   {
+      mutex_lock (&m) ;
+      soma++ ;
+      mutex_unlock (&m) ;
+      sem_down (&s) ;
+      somaSem++ ;
+      sem_up (&s) ;
+      operacoes[id]++ ;
+      if (tarefa[id].preemptCount != 0)
+         erros++ ;
+   }
+   task_exit (0) ;
+}
+
+// cria as tarefas da fase e espera por elas
+void fase (void (*body)(void *))
+{
+   long i ;
+
+   fim = systime () + RUNMS ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_create (&tarefa[i], body, (void *) i) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long i, total = 0 ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mutex_create (&m) ;
+   sem_create (&s, 1) ;
+
+   fase (calculaBody) ;
+   for (i = 0; i < NUMTASKS; i++)
+   {
+      printf ("Tarefa %ld executou %d vezes sem ceder o processador\n", i, trocas[i]) ;
+      if (trocas[i] < 3)
+         erros++ ;
+   }
+
+   fase (sincronizaBody) ;
+   for (i = 0; i < NUMTASKS; i++)
+      total += operacoes[i] ;
+   printf ("Soma %ld e %ld em %ld operacoes\n", soma, somaSem, total) ;
+   if (soma != total || somaSem != total)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Preempcao conferida, resultado correto!\n") ;
+   else
+      printf ("%d erros na preempcao!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
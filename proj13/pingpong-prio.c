@@ -0,0 +1,111 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste do escalonador por prioridades: tarefas criadas juntas, em filas de
+// prioridade diferentes, devem executar da mais para a menos prioritária.
+// Depois, uma tarefa de prioridade baixa disputa o processador com tarefas de
+// prioridade alta que só liberam o processador com task_yield: pelo
+// envelhecimento, ela deve executar antes que as outras terminem, mas bem
+// menos vezes que elas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMTASKS  5
+#define NUMYIELDS 1000
+
+task_t tarefa[NUMTASKS], alta[2], baixa ;
+int prioridade[NUMTASKS] = { 5, -15, 0, 20, -5 } ;
+int esperado[NUMTASKS] = { 1, 4, 2, 0, 3 } ;	// ordem esperada das tarefas
+int ordem[NUMTASKS], executadas = 0 ;
+int voltas = 0, primeiraBaixa = -1, vezesBaixa = 0 ;
+volatile int fim = 0 ;
+
+// registra a ordem em que as tarefas executaram pela primeira vez
+void tarefaBody (void * arg)
+{
+   ordem[executadas++] = (long) arg ;
+   task_exit (0) ;
+}
+
+void altaBody (void * arg)
+{
+   int i ;
+
+   for (i = 0; i < NUMYIELDS; i++)
+   {
+      voltas++ ;
+      task_yield () ;
+   }
+   task_exit (0) ;
+}
+
+void baixaBody (void * arg)
+{
+   while (!fim)
+   {
+      if (primeiraBaixa < 0)
+         primeiraBaixa = voltas ;
+      vezesBaixa++ ;
+      task_yield () ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long i ;
+   int erros = 0 ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   // as tarefas só executam quando a main esperar por elas
+   for (i = 0; i < NUMTASKS; i++)
+   {
+      task_create (&tarefa[i], tarefaBody, (void *) i) ;
+      task_setprio (&tarefa[i], prioridade[i]) ;
+   }
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+
+   printf ("Ordem:") ;
+   for (i = 0; i < NUMTASKS; i++)
+   {
+      printf (" %d (prio %d)", ordem[i], prioridade[ordem[i]]) ;
+      if (ordem[i] != esperado[i])
+         erros++ ;
+   }
+   printf ("\n") ;
+
+   // envelhecimento: a baixa (20) espera no máximo umas 25 escolhas
+   task_create (&baixa, baixaBody, NULL) ;
+   task_setprio (&baixa, 20) ;
+   for (i = 0; i < 2; i++)
+   {
+      task_create (&alta[i], altaBody, NULL) ;
+      task_setprio (&alta[i], -5) ;
+   }
+   for (i = 0; i < 2; i++)
+      task_join (&alta[i]) ;
+   fim = 1 ;
+   task_join (&baixa) ;
+
+   printf ("Baixa executou pela primeira vez depois de %d voltas das altas, e %d vezes em %d voltas\n",
+           primeiraBaixa, vezesBaixa, voltas) ;
+   if (primeiraBaixa < 0 || primeiraBaixa > 2 * NUMYIELDS / 10)
+      erros++ ;
+   if (vezesBaixa == 0 || vezesBaixa > voltas / 5)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Prioridades e envelhecimento conferidos, resultado correto!\n") ;
+   else
+      printf ("%d erros nas prioridades!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,149 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da herança de prioridade nos mutexes. Na primeira parte, uma tarefa
+// de baixa prioridade segura o mutex que uma de alta prioridade espera,
+// enquanto tarefas médias ocupam o processador: a dona deve herdar a
+// prioridade alta e voltar à sua ao liberar o mutex. Na segunda, a herança
+// passa por uma cadeia de donas (C espera B, que espera A) e deve ser
+// desfeita ao longo da cadeia quando C desiste da espera pelo prazo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMMEDIAS 3
+
+task_t baixa, alta, media[NUMMEDIAS] ;
+task_t A, B, C ;
+mutex_t m, m1, m2 ;
+volatile int segura = 0, fim = 0 ;
+int herdou = 0, restaurou = 0 ;
+int durA, durB, depA, depB, fimA ;
+int erros = 0 ;
+
+void baixaBody (void * arg)
+{
+   volatile long i ;
+
+   mutex_lock (&m) ;
+   segura = 1 ;
+   task_sleep_ms (1) ;
+   for (i = 0; i < 30000000; i++)
+      if (baixa.prio == -20)
+         herdou = 1 ;
+   mutex_unlock (&m) ;
+   restaurou = (baixa.prio == 20) ;
+   task_exit (0) ;
+}
+
+void altaBody (void * arg)
+{
+   while (!segura)
+      task_sleep_ms (1) ;
+   mutex_lock (&m) ;
+   mutex_unlock (&m) ;
+   fim = 1 ;
+   task_exit (0) ;
+}
+
+void mediaBody (void * arg)
+{
+   volatile long i ;
+
+   while (!fim)
+      for (i = 0; i < 100000; i++) ;
+   task_exit (0) ;
+}
+
+void ABody (void * arg)
+{
+   mutex_lock (&m2) ;
+   task_sleep_ms (200) ;
+   mutex_unlock (&m2) ;
+   task_exit (0) ;
+}
+
+void BBody (void * arg)
+{
+   task_sleep_ms (5) ;
+   mutex_lock (&m1) ;
+   mutex_lock (&m2) ;
+   mutex_unlock (&m2) ;
+   mutex_unlock (&m1) ;
+   task_exit (0) ;
+}
+
+void CBody (void * arg)
+{
+   task_exit (mutex_lock_timed (&m1, 30)) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i, r ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   // inversão de prioridade: baixa (20), alta (-20) e médias (0)
+   mutex_create (&m) ;
+   task_create (&baixa, baixaBody, NULL) ;
+   task_setprio (&baixa, 20) ;
+   task_create (&alta, altaBody, NULL) ;
+   task_setprio (&alta, -20) ;
+   for (i = 0; i < NUMMEDIAS; i++)
+      task_create (&media[i], mediaBody, NULL) ;
+   task_setprio (NULL, 20) ;
+
+   task_join (&alta) ;
+   for (i = 0; i < NUMMEDIAS; i++)
+      task_join (&media[i]) ;
+   task_join (&baixa) ;
+   task_setprio (NULL, 0) ;
+
+   // a dona herdou a prioridade de quem espera e depois voltou à sua
+   printf ("Baixa herdou %d, restaurou %d, prioridade definida %d\n",
+           herdou, restaurou, task_getprio (&baixa)) ;
+   if (!herdou || !restaurou || task_getprio (&baixa) != 20)
+      erros++ ;
+
+   // cadeia: A (15) segura m2; B (10) segura m1 e espera m2; C (-20) espera m1
+   mutex_create (&m1) ;
+   mutex_create (&m2) ;
+   task_create (&A, ABody, NULL) ;
+   task_setprio (&A, 15) ;
+   task_create (&B, BBody, NULL) ;
+   task_setprio (&B, 10) ;
+   task_sleep_ms (20) ;
+   task_create (&C, CBody, NULL) ;
+   task_setprio (&C, -20) ;
+   task_sleep_ms (5) ;
+   durA = A.prio ;
+   durB = B.prio ;
+   r = task_join (&C) ;
+   depA = A.prio ;
+   depB = B.prio ;
+   task_join (&B) ;
+   fimA = A.prio ;
+   task_join (&A) ;
+
+   // a cadeia herdou a prioridade de C; quando C desistiu pelo prazo, A e B
+   // voltaram à de B, que ainda espera por A, e A depois à sua
+   printf ("Cadeia: A %d e B %d com C esperando, A %d e B %d depois do prazo, A %d no fim\n",
+           durA, durB, depA, depB, fimA) ;
+   if (durA != -20 || durB != -20 || r != -1)
+      erros++ ;
+   if (depA != 10 || depB != 10 || fimA != 15)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Heranca de prioridade conferida, valor correto!\n") ;
+   else
+      printf ("%d erros na heranca de prioridade!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
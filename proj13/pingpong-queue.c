@@ -0,0 +1,122 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste das filas com dono: elementos inseridos no fim ou antes de outro devem
+// ficar na ordem certa e registrar a fila em que estão, e a remoção, que não
+// percorre a fila, deve funcionar na cabeça, no meio e na cauda. Remover um
+// elemento que não está em fila nenhuma deve retornar NULL.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "queue.h"
+
+#define N 10000
+
+typedef struct filaown_t
+{
+   struct filaown_t *prev ;
+   struct filaown_t *next ;
+   struct filaown_t **queue ;
+   int id ;
+} filaown_t ;
+
+filaown_t item[N] ;
+filaown_t *fila0, *fila1 ;
+
+// confere se a fila tem exatamente os ids indicados, nesta ordem, com os
+// apontadores de ida e de volta e a fila registrada em cada elemento
+int fila_confere (filaown_t **fila, int *ids, int n)
+{
+   filaown_t *aux = *fila ;
+   int i ;
+
+   if (queue_size ((queue_t *) *fila) != n)
+      return 0 ;
+   for (i = 0; i < n; i++, aux = aux->next)
+      if (aux->id != ids[i] || aux->queue != fila || aux->next->prev != aux)
+         return 0 ;
+   return aux == *fila || n == 0 ;
+}
+
+int main (int argc, char *argv[])
+{
+   int erros = 0, i ;
+   int ids0[] = { 0, 1, 2, 3, 4 } ;
+   int ids1[] = { 5, 0, 6, 1, 2, 3, 4, 7 } ;
+   int ids2[] = { 0, 6, 1, 3 } ;
+   int ids3[] = { 6, 1, 3 } ;
+
+   printf ("Main INICIO\n") ;
+
+   for (i = 0; i < N; i++)
+   {
+      item[i].id = i ;
+      item[i].prev = item[i].next = NULL ;
+      item[i].queue = NULL ;
+   }
+
+   // inserção no fim e antes de outro elemento (cabeça, meio e fim)
+   for (i = 0; i < 5; i++)
+      queue_append_owned ((queue_owned_t **) &fila0, (queue_owned_t *) &item[i]) ;
+   if (!fila_confere (&fila0, ids0, 5))
+      erros++ ;
+   queue_insert_owned ((queue_owned_t **) &fila0, (queue_owned_t *) &item[5], (queue_owned_t *) &item[0]) ;
+   queue_insert_owned ((queue_owned_t **) &fila0, (queue_owned_t *) &item[6], (queue_owned_t *) &item[1]) ;
+   queue_insert_owned ((queue_owned_t **) &fila0, (queue_owned_t *) &item[7], NULL) ;
+   if (!fila_confere (&fila0, ids1, 8))
+      erros++ ;
+
+   // remoção na cabeça, no meio e na cauda
+   if (queue_remove_owned ((queue_owned_t *) &item[5]) != (queue_owned_t *) &item[5])
+      erros++ ;
+   if (queue_remove_owned ((queue_owned_t *) &item[2]) != (queue_owned_t *) &item[2])
+      erros++ ;
+   if (queue_remove_owned ((queue_owned_t *) &item[4]) != (queue_owned_t *) &item[4])
+      erros++ ;
+   if (queue_remove_owned ((queue_owned_t *) &item[7]) != (queue_owned_t *) &item[7])
+      erros++ ;
+   if (!fila_confere (&fila0, ids2, 4))
+      erros++ ;
+   if (item[5].queue != NULL || item[5].prev != NULL || item[5].next != NULL)
+      erros++ ;
+
+   // um elemento removido não está em fila nenhuma, mas pode entrar em outra
+   printf ("Removendo elemento fora de fila (com DEBUG, gera msg de erro):\n") ;
+   if (queue_remove_owned ((queue_owned_t *) &item[5]) != NULL)
+      erros++ ;
+   if (queue_remove_owned ((queue_owned_t *) &item[0]) == NULL)
+      erros++ ;
+   queue_append_owned ((queue_owned_t **) &fila1, (queue_owned_t *) &item[0]) ;
+   if (!fila_confere (&fila0, ids3, 3) || item[0].queue != &fila1 || queue_size ((queue_t *) fila1) != 1)
+      erros++ ;
+   queue_remove_owned ((queue_owned_t *) &item[0]) ;
+   if (fila1 != NULL)
+      erros++ ;
+
+   // esvazia a fila pela cauda, pelo elemento do meio e pela cabeça
+   queue_remove_owned ((queue_owned_t *) &item[3]) ;
+   queue_remove_owned ((queue_owned_t *) &item[1]) ;
+   queue_remove_owned ((queue_owned_t *) &item[6]) ;
+   if (fila0 != NULL || queue_size ((queue_t *) fila0) != 0)
+      erros++ ;
+
+   // muitos elementos, removidos fora de ordem: pares primeiro, depois ímpares
+   for (i = 0; i < N; i++)
+      queue_append_owned ((queue_owned_t **) &fila0, (queue_owned_t *) &item[i]) ;
+   for (i = 0; i < N; i += 2)
+      queue_remove_owned ((queue_owned_t *) &item[i]) ;
+   if (queue_size ((queue_t *) fila0) != N / 2 || fila0->id != 1 || fila0->prev->id != N - 1)
+      erros++ ;
+   for (i = N - 1; i > 0; i -= 2)
+      queue_remove_owned ((queue_owned_t *) &item[i]) ;
+   if (fila0 != NULL)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Filas com dono conferidas, resultado correto!\n") ;
+   else
+      printf ("%d erros nas filas com dono!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+
+   exit (0) ;
+}
@@ -0,0 +1,114 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da leitura antecipada: uma tarefa que lê blocos em sequência deve
+// encontrar a maioria deles já trazidos para a cache, tanto no sentido
+// crescente quanto no decrescente, enquanto leituras em ordem aleatória
+// quase não disparam antecipações. O conteúdo lido é conferido com o lido
+// antes, com a cache desativada.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+#include "diskdriver.h"
+
+#define FIRSTBLOCK 100
+#define NUMBLOCKS  64
+#define NUMRANDOM  32
+#define CACHESIZE  64
+
+task_t leitor ;
+int numBlocks ;			// numero de blocos no disco
+int blockSize ;			// tamanho de cada bloco (bytes)
+char *referencia ;		// conteudo dos blocos lidos sem a cache
+int erros = 0 ;
+
+// lê o bloco e confere com a referência
+void confere (int block, char *buffer)
+{
+   if (disk_block_read (block, buffer) < 0
+       || memcmp (buffer, referencia + (block - FIRSTBLOCK) * blockSize, blockSize))
+      erros++ ;
+}
+
+// percorre os blocos em sequência, processando cada um por alguns ms
+void leitorBody (void * arg)
+{
+   long sentido = (long) arg ;
+   char *buffer = malloc (blockSize) ;
+   int k ;
+
+   for (k = 0; k < NUMBLOCKS; k++)
+   {
+      confere (sentido > 0 ? FIRSTBLOCK + k : FIRSTBLOCK + NUMBLOCKS - 1 - k, buffer) ;
+      task_sleep_ms (5) ;
+   }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+// lê a sequência num sentido e informa quantos blocos antecipados foram usados
+long percorre (long sentido, char *nome)
+{
+   long emitidas, usadas, emitidas0, usadas0 ;
+
+   disk_cache_size (0) ;
+   disk_cache_size (CACHESIZE) ;
+   disk_readahead_stats (&emitidas0, &usadas0) ;
+   task_create (&leitor, leitorBody, (void *) sentido) ;
+   task_join (&leitor) ;
+   disk_readahead_stats (&emitidas, &usadas) ;
+   printf ("%s: %ld blocos antecipados, %ld usados\n", nome,
+           emitidas - emitidas0, usadas - usadas0) ;
+   return usadas - usadas0 ;
+}
+
+int main (int argc, char *argv[])
+{
+   char *buffer ;
+   long i, crescente, decrescente, emitidas, usadas, emitidas0, usadas0 ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   if (diskdriver_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   // referência, lida direto do disco
+   disk_cache_size (0) ;
+   referencia = malloc (NUMBLOCKS * blockSize) ;
+   buffer = malloc (blockSize) ;
+   disk_block_readv (FIRSTBLOCK, NUMBLOCKS, referencia) ;
+
+   crescente = percorre (1, "crescente") ;
+   decrescente = percorre (-1, "decrescente") ;
+
+   // em ordem aleatória
+   disk_cache_size (0) ;
+   disk_cache_size (CACHESIZE) ;
+   disk_readahead_stats (&emitidas0, &usadas0) ;
+   for (i = 0; i < NUMRANDOM; i++)
+      confere (FIRSTBLOCK + (i * 37) % NUMBLOCKS, buffer) ;
+   disk_readahead_stats (&emitidas, &usadas) ;
+   emitidas -= emitidas0 ;
+   printf ("aleatorio: %ld blocos antecipados\n", emitidas) ;
+
+   free (referencia) ;
+   free (buffer) ;
+
+   if (erros == 0 && crescente > NUMBLOCKS / 2 && decrescente > NUMBLOCKS / 2
+       && emitidas < NUMRANDOM / 4)
+      printf ("Leitura antecipada conferida, conteudo correto!\n") ;
+   else
+      printf ("%d erros, %ld e %ld blocos antecipados usados, %ld antecipados ao acaso!\n",
+              erros, crescente, decrescente, emitidas) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,156 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da leitura e escrita de vários blocos num só pedido: disk_block_readv
+// deve ser mais rápida que as leituras bloco a bloco, pedidos de tarefas
+// diferentes para blocos vizinhos devem ir juntos ao disco, e um
+// disk_block_writev maior que a cache deve chegar inteiro ao disco. Os blocos
+// alterados são restaurados no fim.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+#include "diskdriver.h"
+
+#define NUMBLOCKS  32		// blocos da leitura em um só pedido
+#define NUMTASKS   8
+#define READBLOCK  100		// blocos lidos pelas tarefas
+#define WRITEBLOCK 120		// blocos escritos pelas tarefas
+#define VECBLOCK   200		// blocos do disk_block_writev
+#define VECBLOCKS  20
+#define CACHESIZE  16
+
+task_t tarefa[NUMTASKS] ;
+int numBlocks ;			// numero de blocos no disco
+int blockSize ;			// tamanho de cada bloco (bytes)
+char *referencia ;		// conteudo original dos blocos READBLOCK...
+int erros = 0 ;
+
+void leitorBody (void * arg)
+{
+   long i = (long) arg ;
+   char *buffer = malloc (blockSize) ;
+
+   if (disk_block_read (READBLOCK + i, buffer) < 0
+       || memcmp (buffer, referencia + i * blockSize, blockSize))
+      erros++ ;
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+void escritorBody (void * arg)
+{
+   long i = (long) arg ;
+   char *buffer = malloc (blockSize) ;
+
+   memset (buffer, 'a' + i, blockSize) ;
+   if (disk_block_write (WRITEBLOCK + i, buffer) < 0)
+      erros++ ;
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+// cria NUMTASKS tarefas com o corpo indicado e informa quantos comandos o
+// disco recebeu para os pedidos delas
+void rodada (void (*body)(void *), long *pedidos, long *comandos)
+{
+   long i, p0, c0, m, l ;
+
+   disk_stats (&p0, &m, &l) ;
+   disk_command_stats (&c0) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_create (&tarefa[i], body, (void *) i) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+   disk_stats (pedidos, &m, &l) ;
+   disk_command_stats (comandos) ;
+   *pedidos -= p0 ;
+   *comandos -= c0 ;
+}
+
+int main (int argc, char *argv[])
+{
+   char *vetor, *lido, *original ;
+   long i, pedidosL, comandosL, pedidosE, comandosE ;
+   unsigned int inicio, tempoV, tempoB ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   if (diskdriver_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   disk_cache_size (0) ;
+   vetor = malloc (NUMBLOCKS * blockSize) ;
+   lido = malloc (NUMBLOCKS * blockSize) ;
+   referencia = malloc (NUMTASKS * blockSize) ;
+   original = malloc ((WRITEBLOCK + NUMTASKS - READBLOCK + VECBLOCKS) * blockSize) ;
+
+   // guarda o conteúdo original dos blocos que serão alterados
+   disk_block_readv (READBLOCK, WRITEBLOCK + NUMTASKS - READBLOCK, original) ;
+   disk_block_readv (VECBLOCK, VECBLOCKS, original + (WRITEBLOCK + NUMTASKS - READBLOCK) * blockSize) ;
+   memcpy (referencia, original, NUMTASKS * blockSize) ;
+
+   // um pedido de NUMBLOCKS blocos contra NUMBLOCKS pedidos de um bloco
+   inicio = systime () ;
+   if (disk_block_readv (0, NUMBLOCKS, vetor) < 0)
+      erros++ ;
+   tempoV = systime () - inicio ;
+   inicio = systime () ;
+   for (i = 0; i < NUMBLOCKS; i++)
+      if (disk_block_read (i, lido) < 0 || memcmp (lido, vetor + i * blockSize, blockSize))
+         erros++ ;
+   tempoB = systime () - inicio ;
+   printf ("%d blocos: um pedido em %u ms, um por bloco em %u ms\n",
+           NUMBLOCKS, tempoV, tempoB) ;
+
+   // pedidos vizinhos de tarefas diferentes
+   rodada (leitorBody, &pedidosL, &comandosL) ;
+   rodada (escritorBody, &pedidosE, &comandosE) ;
+   printf ("%d leitores: %ld pedidos em %ld comandos; %d escritores: %ld pedidos em %ld comandos\n",
+           NUMTASKS, pedidosL, comandosL, NUMTASKS, pedidosE, comandosE) ;
+   if (disk_block_readv (WRITEBLOCK, NUMTASKS, lido) < 0)
+      erros++ ;
+   for (i = 0; i < NUMTASKS; i++)
+      if (lido[i * blockSize] != 'a' + i)
+         erros++ ;
+
+   // escrita maior que a cache, conferida depois no disco
+   disk_cache_size (CACHESIZE) ;
+   for (i = 0; i < VECBLOCKS; i++)
+      memset (vetor + i * blockSize, 'A' + i, blockSize) ;
+   if (disk_block_writev (VECBLOCK, VECBLOCKS, vetor) < 0)
+      erros++ ;
+   disk_cache_size (0) ;
+   memset (lido, 0, VECBLOCKS * blockSize) ;
+   if (disk_block_readv (VECBLOCK, VECBLOCKS, lido) < 0 || memcmp (lido, vetor, VECBLOCKS * blockSize))
+      erros++ ;
+
+   // pedidos fora do disco ou vazios são recusados
+   if (disk_block_readv (numBlocks - 5, 10, lido) != -1 || disk_block_readv (0, 0, lido) != -1
+       || disk_block_writev (-1, 2, lido) != -1)
+      erros++ ;
+
+   // restaura o conteúdo original
+   disk_block_writev (READBLOCK, WRITEBLOCK + NUMTASKS - READBLOCK, original) ;
+   disk_block_writev (VECBLOCK, VECBLOCKS, original + (WRITEBLOCK + NUMTASKS - READBLOCK) * blockSize) ;
+
+   free (vetor) ;
+   free (lido) ;
+   free (referencia) ;
+   free (original) ;
+
+   if (erros == 0 && tempoV < tempoB && comandosL < pedidosL && comandosE < pedidosE)
+      printf ("Pedidos de varios blocos conferidos, conteudo correto!\n") ;
+   else
+      printf ("%d erros nos pedidos de varios blocos!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
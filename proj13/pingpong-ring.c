@@ -0,0 +1,146 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste do buffer circular das filas de mensagens: com capacidade pequena e
+// mensagens de tamanho ímpar, as posições de envio e de recebimento dão a volta
+// no buffer muitas vezes, e as mensagens devem sair inteiras e na ordem em que
+// entraram, tanto na fila comum quanto na SPSC. mqueue_msgs deve acompanhar
+// a ocupação da fila.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+
+#define CAPACITY 5
+#define MSGSIZE  7
+#define NUMMSGS  1003
+
+typedef struct { char byte[MSGSIZE] ; } msg_t ;
+
+task_t produtor, consumidor ;
+mqueue_t fila ;
+int erros = 0 ;
+
+// a mensagem n tem todos os bytes diferentes, para detectar deslocamentos
+void monta (msg_t *msg, int n)
+{
+   int i ;
+
+   for (i = 0; i < MSGSIZE; i++)
+      msg->byte[i] = n * MSGSIZE + i ;
+}
+
+int confere (msg_t *msg, int n)
+{
+   msg_t esperada ;
+
+   monta (&esperada, n) ;
+   return memcmp (msg, &esperada, MSGSIZE) == 0 ;
+}
+
+void produtorBody (void * arg)
+{
+   msg_t msg ;
+   int i ;
+
+   for (i = 0; i < NUMMSGS; i++)
+   {
+      monta (&msg, i) ;
+      if (mqueue_send (&fila, &msg) < 0)
+         erros++ ;
+   }
+   task_exit (0) ;
+}
+
+void consumidorBody (void * arg)
+{
+   msg_t msg ;
+   int i ;
+
+   for (i = 0; i < NUMMSGS; i++)
+   {
+      if (mqueue_recv (&fila, &msg) < 0 || !confere (&msg, i))
+         erros++ ;
+      if (mqueue_msgs (&fila) < 0 || mqueue_msgs (&fila) > CAPACITY)
+         erros++ ;
+   }
+   task_exit (0) ;
+}
+
+// enche e esvazia a fila aos poucos, conferindo a ocupação a cada passo
+void enche_esvazia (void)
+{
+   msg_t msg ;
+   int enviadas = 0, recebidas = 0, volta, i ;
+
+   for (volta = 0; volta < 2 * CAPACITY; volta++)
+   {
+      // enche a fila, que recusa uma mensagem a mais
+      monta (&msg, enviadas) ;
+      while (mqueue_send_try (&fila, &msg) == 0)
+         monta (&msg, ++enviadas) ;
+      if (mqueue_msgs (&fila) != CAPACITY || enviadas - recebidas != CAPACITY)
+         erros++ ;
+
+      // retira algumas (um número diferente a cada volta)
+      for (i = 0; i <= volta % CAPACITY; i++)
+      {
+         if (mqueue_recv_try (&fila, &msg) < 0 || !confere (&msg, recebidas))
+            erros++ ;
+         recebidas++ ;
+      }
+      if (mqueue_msgs (&fila) != enviadas - recebidas)
+         erros++ ;
+   }
+
+   // esvazia a fila, que então recusa o recebimento
+   while (mqueue_recv_try (&fila, &msg) == 0)
+   {
+      if (!confere (&msg, recebidas))
+         erros++ ;
+      recebidas++ ;
+   }
+   if (mqueue_msgs (&fila) != 0 || recebidas != enviadas)
+      erros++ ;
+}
+
+// testa uma fila já criada: na própria main e entre duas tarefas
+void testa (const char *tipo)
+{
+   int antes = erros ;
+
+   enche_esvazia () ;
+
+   task_create (&produtor, produtorBody, NULL) ;
+   task_create (&consumidor, consumidorBody, NULL) ;
+   task_join (&produtor) ;
+   task_join (&consumidor) ;
+   if (mqueue_msgs (&fila) != 0)
+      erros++ ;
+
+   printf ("Fila %s: %d erros\n", tipo, erros - antes) ;
+   mqueue_destroy (&fila) ;
+}
+
+int main (int argc, char *argv[])
+{
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mqueue_create (&fila, CAPACITY, MSGSIZE) ;
+   testa ("comum") ;
+
+   mqueue_create_spsc (&fila, CAPACITY, MSGSIZE) ;
+   testa ("SPSC") ;
+
+   if (erros == 0)
+      printf ("Buffer circular conferido, resultado correto!\n") ;
+   else
+      printf ("%d erros no buffer circular!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
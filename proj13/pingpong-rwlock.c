@@ -0,0 +1,155 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da trava de leitores e escritores: leitores conferem que a tabela
+// protegida nunca aparece pela metade enquanto escritores a atualizam; vários
+// leitores devem poder ler ao mesmo tempo, e só quem detém a trava pode
+// liberá-la. Uma tarefa que já lê a trava deve obtê-la de novo mesmo com um
+// escritor esperando, e pode ler várias travas ao mesmo tempo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMREADERS 6
+#define NUMWRITERS 2
+#define NUMREADS   2000
+#define NUMWRITES  500
+#define TABLESIZE  4
+#define NUMLOCKS   8
+
+task_t leitor[NUMREADERS], escritor[NUMWRITERS], intruso, tardio ;
+rwlock_t rw, varias[NUMLOCKS] ;
+mutex_t contador ;	// protege leitores, que vários leitores alteram juntos
+int tabela[TABLESIZE] ;
+int leitores = 0, maxLeitores = 0, erros = 0, unlockIntruso, escreveu = 0 ;
+
+void leitorBody (void * arg)
+{
+   int i, k ;
+
+   for (i = 0; i < NUMREADS; i++)
+   {
+      rwlock_rdlock (&rw) ;
+      mutex_lock (&contador) ;
+      leitores++ ;
+      if (leitores > maxLeitores)
+         maxLeitores = leitores ;
+      mutex_unlock (&contador) ;
+      for (k = 1; k < TABLESIZE; k++)
+         if (tabela[k] != tabela[0])
+            erros++ ;
+      if (i % 50 == 0)
+         task_yield () ;
+      mutex_lock (&contador) ;
+      leitores-- ;
+      mutex_unlock (&contador) ;
+      rwlock_unlock (&rw) ;
+   }
+   task_exit (0) ;
+}
+
+void escritorBody (void * arg)
+{
+   int i, k ;
+
+   for (i = 0; i < NUMWRITES; i++)
+   {
+      rwlock_wrlock (&rw) ;
+      if (leitores)
+         erros++ ;
+      for (k = 0; k < TABLESIZE; k++)
+      {
+         tabela[k]++ ;
+         if (k == 1 && i % 10 == 0)
+            task_yield () ;
+      }
+      rwlock_unlock (&rw) ;
+   }
+   task_exit (0) ;
+}
+
+void intrusoBody (void * arg)
+{
+   unlockIntruso = rwlock_unlock (&rw) ;
+   task_exit (0) ;
+}
+
+// escritor que chega com a trava já lida por main
+void tardioBody (void * arg)
+{
+   if (rwlock_wrlock (&rw) == 0)
+   {
+      escreveu = 1 ;
+      rwlock_unlock (&rw) ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int i, unlockLivre, unlockLeitor, releitura, multiplas ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   rwlock_create (&rw) ;
+   mutex_create (&contador) ;
+
+   for (i = 0; i < NUMREADERS; i++)
+      task_create (&leitor[i], leitorBody, NULL) ;
+   for (i = 0; i < NUMWRITERS; i++)
+      task_create (&escritor[i], escritorBody, NULL) ;
+   for (i = 0; i < NUMREADERS; i++)
+      task_join (&leitor[i]) ;
+   for (i = 0; i < NUMWRITERS; i++)
+      task_join (&escritor[i]) ;
+
+   // liberar sem deter a trava deve ser recusado
+   unlockLivre = rwlock_unlock (&rw) ;
+   rwlock_rdlock (&rw) ;
+   task_create (&intruso, intrusoBody, NULL) ;
+   task_join (&intruso) ;
+   unlockLeitor = rwlock_unlock (&rw) ;
+
+   // a segunda leitura não espera o escritor, que espera a primeira acabar
+   rwlock_rdlock (&rw) ;
+   task_create (&tardio, tardioBody, NULL) ;
+   task_sleep_ms (5) ;
+   releitura = rwlock_rdlock (&rw) ;
+   releitura += rwlock_unlock (&rw) ;
+   releitura += escreveu ;
+   rwlock_unlock (&rw) ;
+   task_join (&tardio) ;
+
+   // várias travas lidas ao mesmo tempo pela mesma tarefa
+   multiplas = 0 ;
+   for (i = 0; i < NUMLOCKS; i++)
+   {
+      rwlock_create (&varias[i]) ;
+      multiplas += (rwlock_rdlock (&varias[i]) == 0) ;
+   }
+   for (i = 0; i < NUMLOCKS; i++)
+   {
+      multiplas += (rwlock_unlock (&varias[i]) == 0) ;
+      rwlock_destroy (&varias[i]) ;
+   }
+
+   rwlock_destroy (&rw) ;
+   mutex_destroy (&contador) ;
+
+   if (erros == 0 && tabela[0] == NUMWRITERS * NUMWRITES && maxLeitores > 1
+       && unlockLivre == -1 && unlockIntruso == -1 && unlockLeitor == 0
+       && releitura == 0 && escreveu && multiplas == 2 * NUMLOCKS)
+      printf ("Tabela deu %d, ate %d leitores juntos, valor correto!\n",
+              tabela[0], maxLeitores) ;
+   else
+      printf ("Tabela deu %d, mas deveria ser %d (%d erros, ate %d leitores, unlocks %d %d %d, releitura %d, %d travas)!\n",
+              tabela[0], NUMWRITERS * NUMWRITES, erros, maxLeitores,
+              unlockLivre, unlockIntruso, unlockLeitor, releitura, multiplas / 2) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
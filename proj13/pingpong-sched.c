@@ -0,0 +1,115 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste das políticas de escalonamento do disco: enquanto o disco atende uma
+// leitura do bloco 100, chegam pedidos para blocos espalhados, que cada
+// política deve atender na sua ordem. Como o disco só pode ser iniciado uma
+// vez por processo, cada política é testada num processo filho.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "pingpong.h"
+#include "diskdriver.h"
+
+#define NUMREQS  6
+#define NUMPOLS  4
+#define BUSYBLK  100
+
+task_t ocupa, leitora[NUMREQS] ;
+int bloco[NUMREQS] = { 157, 22, 131, 64, 190, 96 } ;	// ordem de chegada
+int esperado[NUMPOLS][NUMREQS] =
+{
+   { 157, 22, 131, 64, 190, 96 },	// FCFS
+   { 96, 64, 22, 131, 157, 190 },	// SSTF
+   { 131, 157, 190, 96, 64, 22 },	// SCAN
+   { 131, 157, 190, 22, 64, 96 },	// C-SCAN
+} ;
+int politica[NUMPOLS] = { DISK_SCHED_FCFS, DISK_SCHED_SSTF, DISK_SCHED_SCAN, DISK_SCHED_CSCAN } ;
+char *nome[NUMPOLS] = { "FCFS", "SSTF", "SCAN", "C-SCAN" } ;
+int ordem[NUMREQS + 1], atendidos = 0 ;	// inclui a leitura do bloco 100
+char *buffer ;
+
+// lê um bloco, registrando a ordem em que as leituras terminaram
+void leitoraBody (void * arg)
+{
+   if (disk_block_read ((long) arg, buffer) == 0)
+      ordem[atendidos++] = (long) arg ;
+   task_exit (0) ;
+}
+
+// testa uma política no processo corrente; retorna o número de erros
+int testa (int p)
+{
+   int numBlocks, blockSize, erros = 0, i ;
+
+   pingpong_init () ;
+
+   if (diskdriver_init_sched (&numBlocks, &blockSize, politica[p]) < 0)
+   {
+      printf ("%s: erro na abertura do disco\n", nome[p]) ;
+      return 1 ;
+   }
+   disk_cache_size (0) ;
+   buffer = malloc (blockSize) ;
+
+   // os pedidos chegam enquanto o disco lê o bloco 100
+   task_create (&ocupa, leitoraBody, (void *) BUSYBLK) ;
+   task_sleep_ms (5) ;
+   for (i = 0; i < NUMREQS; i++)
+      task_create (&leitora[i], leitoraBody, (void *) (long) bloco[i]) ;
+   task_join (&ocupa) ;
+   for (i = 0; i < NUMREQS; i++)
+      task_join (&leitora[i]) ;
+
+   // a leitura do bloco 100 é a primeira a terminar
+   printf ("%s:", nome[p]) ;
+   for (i = 1; i <= NUMREQS; i++)
+   {
+      printf (" %d", ordem[i]) ;
+      if (ordem[i] != esperado[p][i - 1])
+         erros++ ;
+   }
+   printf ("\n") ;
+   if (atendidos != NUMREQS + 1 || ordem[0] != BUSYBLK)
+      erros++ ;
+
+   free (buffer) ;
+   return erros ;
+}
+
+int main (int argc, char *argv[])
+{
+   int erros = 0, status, p ;
+   pid_t filho ;
+
+   printf ("Main INICIO\n") ;
+   fflush (stdout) ;
+
+   for (p = 0; p < NUMPOLS; p++)
+   {
+      filho = fork () ;
+      if (filho < 0)
+      {
+         perror ("Erro no fork: ") ;
+         exit (1) ;
+      }
+      if (filho == 0)
+      {
+         status = testa (p) ;
+         fflush (stdout) ;
+         _exit (status ? 1 : 0) ;
+      }
+      if (waitpid (filho, &status, 0) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+         erros++ ;
+   }
+
+   if (erros == 0)
+      printf ("Politicas de escalonamento do disco conferidas, resultado correto!\n") ;
+   else
+      printf ("%d politicas de escalonamento do disco com erros!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+
+   exit (0) ;
+}
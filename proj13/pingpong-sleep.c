@@ -0,0 +1,106 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste do heap de tarefas dormindo: tarefas que dormem tempos diferentes,
+// criadas fora de ordem, devem acordar em ordem crescente de prazo, e as de
+// mesmo prazo na ordem em que adormeceram. Se o heap não puder crescer,
+// task_sleep_ms deve retornar -1 sem dormir.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "pingpong.h"
+
+#define NUMSLEEPERS 8
+#define NUMFILLERS  16		// tarefas que enchem o heap na segunda parte
+
+task_t dorminhoca[NUMSLEEPERS], enchimento[NUMFILLERS] ;
+int duracao[NUMSLEEPERS] = { 70, 30, 50, 30, 10, 90, 50, 30 } ;
+int esperado[NUMSLEEPERS] = { 4, 1, 3, 7, 2, 6, 0, 5 } ;	// ordem esperada
+int ordem[NUMSLEEPERS], acordadas = 0 ;
+
+// realloc falha enquanto falhaRealloc estiver ligado, simulando a falta de
+// memória ao aumentar o heap; fora disso, usa o realloc da biblioteca
+extern void *__libc_realloc (void *ptr, size_t size) ;
+int falhaRealloc = 0 ;
+
+void *realloc (void *ptr, size_t size)
+{
+   if (falhaRealloc)
+   {
+      errno = ENOMEM ;
+      return NULL ;
+   }
+   return __libc_realloc (ptr, size) ;
+}
+
+void dorminhocaBody (void * arg)
+{
+   long i = (long) arg ;
+
+   task_sleep_ms (duracao[i]) ;
+   ordem[acordadas++] = i ;
+   task_exit (0) ;
+}
+
+void enchimentoBody (void * arg)
+{
+   task_sleep_ms (200) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long i ;
+   int erros = 0, r ;
+   unsigned int inicio, tempo ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   for (i = 0; i < NUMSLEEPERS; i++)
+      task_create (&dorminhoca[i], dorminhocaBody, (void *) i) ;
+   for (i = 0; i < NUMSLEEPERS; i++)
+      task_join (&dorminhoca[i]) ;
+
+   printf ("Ordem:") ;
+   for (i = 0; i < NUMSLEEPERS; i++)
+   {
+      printf (" %d (%d ms)", ordem[i], duracao[ordem[i]]) ;
+      if (ordem[i] != esperado[i])
+         erros++ ;
+   }
+   printf ("\n") ;
+
+   // com o heap cheio, dormir exige aumentá-lo
+   for (i = 0; i < NUMFILLERS; i++)
+      task_create (&enchimento[i], enchimentoBody, NULL) ;
+   task_yield () ;
+   inicio = systime () ;
+   falhaRealloc = 1 ;
+   r = task_sleep_ms (100) ;
+   falhaRealloc = 0 ;
+   tempo = systime () - inicio ;
+   printf ("Sem memoria, task_sleep_ms retornou %d em %u ms\n", r, tempo) ;
+   if (r != -1 || tempo >= 100)
+      erros++ ;
+
+   // com memória, dorme normalmente
+   inicio = systime () ;
+   if (task_sleep_ms (50) != 0 || systime () - inicio < 50)
+      erros++ ;
+   if (task_sleep (0) != 0)
+      erros++ ;
+   for (i = 0; i < NUMFILLERS; i++)
+      task_join (&enchimento[i]) ;
+
+   if (erros == 0)
+      printf ("Tarefas dormindo conferidas, resultado correto!\n") ;
+   else
+      printf ("%d erros nas tarefas dormindo!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,112 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste dos núcleos com filas próprias: tarefas presas ao núcleo 0 nunca
+// devem entrar na fila de outro núcleo, e as tarefas livres, que ocupam o
+// processador, devem terminar com a soma correta. Compilado com SMP numa
+// máquina com mais de um processador, as tarefas livres devem se espalhar por
+// mais de um núcleo (pelo roubo de tarefas).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pingpong.h"
+
+#define NUMPINNED 3
+#define NUMFREE   8
+#define NUMLOOPS  200
+#define NUMSPINS  200000
+
+task_t presa[NUMPINNED], livre[NUMFREE] ;
+mutex_t m ;
+long soma = 0 ;
+int migracoes = 0 ;
+struct core_t *nucleoLivre[NUMFREE] ;
+int nucleosLivres[NUMFREE] ;
+
+// soma sua parte, conferindo a cada volta se continua no mesmo núcleo
+void presaBody (void * arg)
+{
+   task_t *eu = &presa[(long) arg] ;
+   struct core_t *nucleo = eu->core ;
+   int i ;
+
+   for (i = 0; i < NUMLOOPS; i++)
+   {
+      mutex_lock (&m) ;
+      soma++ ;
+      mutex_unlock (&m) ;
+      task_yield () ;
+      if (eu->core != nucleo)
+         migracoes++ ;
+   }
+   task_exit (0) ;
+}
+
+// ocupa o processador, anotando os núcleos em que executou
+void livreBody (void * arg)
+{
+   long n = (long) arg ;
+   volatile long j ;
+   int i ;
+
+   for (i = 0; i < NUMLOOPS; i++)
+   {
+      for (j = 0; j < NUMSPINS; j++) ;
+      if (livre[n].core != nucleoLivre[n])
+      {
+         nucleoLivre[n] = livre[n].core ;
+         nucleosLivres[n]++ ;
+      }
+      mutex_lock (&m) ;
+      soma++ ;
+      mutex_unlock (&m) ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   task_attr_t attr ;
+   long i ;
+   int espalhou = 0, esperaEspalhar = 0 ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mutex_create (&m) ;
+
+   task_attr_init (&attr) ;
+   attr.affinity = 0 ;
+   for (i = 0; i < NUMPINNED; i++)
+      task_create_ex (&presa[i], presaBody, (void *) i, &attr) ;
+   for (i = 0; i < NUMFREE; i++)
+      task_create (&livre[i], livreBody, (void *) i) ;
+
+   for (i = 0; i < NUMPINNED; i++)
+      task_join (&presa[i]) ;
+   for (i = 0; i < NUMFREE; i++)
+   {
+      task_join (&livre[i]) ;
+      if (nucleosLivres[i] > 1)
+         espalhou = 1 ;
+   }
+
+#ifdef SMP
+   esperaEspalhar = (sysconf (_SC_NPROCESSORS_ONLN) > 1) ;
+#endif
+
+   printf ("Soma %ld, %d migracoes de tarefas presas, tarefas livres %s\n", soma,
+           migracoes, espalhou ? "em mais de um nucleo" : "num so nucleo") ;
+
+   if (soma == (NUMPINNED + NUMFREE) * NUMLOOPS && migracoes == 0 && (espalhou || !esperaEspalhar))
+      printf ("Filas por nucleo conferidas, resultado correto!\n") ;
+   else
+      printf ("Soma deveria ser %d, sem migracoes de tarefas presas!\n",
+              (NUMPINNED + NUMFREE) * NUMLOOPS) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
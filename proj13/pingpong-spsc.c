@@ -0,0 +1,89 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da fila de mensagens de um produtor e um consumidor
+// (mqueue_create_spsc): o consumidor alterna entre mqueue_recv e
+// mqueue_recv_n e confere a ordem e o conteúdo de cada mensagem.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMMSGS   300000
+#define RECVBATCH 16
+
+task_t prod, cons ;
+mqueue_t fila ;
+long int soma = 0 ;
+int erros = 0 ;
+
+void prodBody (void * arg)
+{
+   long int msg[2], i ;
+
+   for (i = 0; i < NUMMSGS; i++)
+   {
+      msg[0] = i ;
+      msg[1] = ~i ;
+      mqueue_send (&fila, msg) ;
+      if (i % 1000 == 0)
+         task_yield () ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   long int msgs[RECVBATCH][2], proxima = 0 ;
+   int j, k ;
+
+   while (proxima < NUMMSGS)
+   {
+      if (proxima & 1)
+         k = mqueue_recv_n (&fila, msgs, RECVBATCH) ;
+      else
+         k = (mqueue_recv (&fila, msgs[0]) == 0) ;
+      for (j = 0; j < k; j++)
+      {
+         if (msgs[j][0] != proxima || msgs[j][1] != ~proxima)
+            erros++ ;
+         soma += msgs[j][0] ;
+         proxima++ ;
+      }
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long int esperado = (long) NUMMSGS * (NUMMSGS - 1) / 2 ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mqueue_create_spsc (&fila, 8, 2 * sizeof(long int)) ;
+
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   if (soma == esperado && erros == 0)
+      printf ("Soma deu %ld, valor correto!\n", soma) ;
+   else
+      printf ("Soma deu %ld, mas deveria ser %ld (%d mensagens erradas)!\n",
+              soma, esperado, erros) ;
+
+   // a troca sem cópia não vale para filas SPSC
+   if (mqueue_alloc (&fila) == NULL)
+      printf ("mqueue_alloc recusado na fila SPSC, correto!\n") ;
+   else
+      printf ("mqueue_alloc deveria ser recusado na fila SPSC!\n") ;
+
+   mqueue_destroy (&fila) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
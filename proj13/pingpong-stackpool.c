@@ -0,0 +1,95 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste do pool de pilhas: depois que um lote de tarefas termina, um novo lote
+// com pilhas da mesma classe de tamanho deve reaproveitar todas as pilhas
+// liberadas, mesmo pedindo tamanhos diferentes dentro da classe. Pilhas maiores
+// que a maior classe não passam pelo pool e são sempre alocadas.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+
+#define NUMTASKS 10
+#define NUMBIG   3
+#define BIGSTACK (2 * 1024 * 1024)
+
+task_t tarefa[NUMTASKS] ;
+int soma = 0 ;
+
+// usa um pedaço da pilha, para que uma pilha reaproveitada seja de fato tocada
+void tarefaBody (void * arg)
+{
+   char buffer[8192] ;
+
+   memset (buffer, (long) arg, sizeof (buffer)) ;
+   soma += buffer[sizeof (buffer) - 1] ;
+   task_exit (0) ;
+}
+
+// cria e espera um lote de n tarefas com pilhas de stacksize bytes,
+// informando quantas pilhas vieram do pool e quantas foram alocadas
+void lote (int n, int stacksize, long *hits, long *misses)
+{
+   long h0, m0, i ;
+
+   task_stack_stats (&h0, &m0) ;
+   for (i = 0; i < n; i++)
+      task_create_stack (&tarefa[i], tarefaBody, (void *) (i + 1), stacksize) ;
+   for (i = 0; i < n; i++)
+      task_join (&tarefa[i]) ;
+   task_stack_stats (hits, misses) ;
+   *hits -= h0 ;
+   *misses -= m0 ;
+
+   printf ("Lote de %d pilhas de %d bytes: %ld do pool, %ld alocadas\n", n,
+           stacksize, *hits, *misses) ;
+}
+
+int main (int argc, char *argv[])
+{
+   long hits, misses ;
+   int erros = 0, esperado = 0, i ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   // o primeiro lote enche o pool da classe
+   lote (NUMTASKS, 20000, &hits, &misses) ;
+   if (hits + misses != NUMTASKS)
+      erros++ ;
+
+   // os seguintes, na mesma classe, só reaproveitam
+   lote (NUMTASKS, 20000, &hits, &misses) ;
+   if (hits != NUMTASKS || misses != 0)
+      erros++ ;
+   lote (NUMTASKS, 30000, &hits, &misses) ;
+   if (hits != NUMTASKS || misses != 0)
+      erros++ ;
+
+   // fora das classes, sempre alocadas
+   lote (NUMBIG, BIGSTACK, &hits, &misses) ;
+   if (hits != 0 || misses != NUMBIG)
+      erros++ ;
+   lote (NUMBIG, BIGSTACK, &hits, &misses) ;
+   if (hits != 0 || misses != NUMBIG)
+      erros++ ;
+
+   for (i = 1; i <= NUMTASKS; i++)
+      esperado += 3 * i ;
+   for (i = 1; i <= NUMBIG; i++)
+      esperado += 2 * i ;
+   if (soma != esperado)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Pool de pilhas conferido, resultado correto!\n") ;
+   else
+      printf ("%d erros no pool de pilhas!\n", erros) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -0,0 +1,241 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste das variantes _try e _timed das operações bloqueantes: semáforos,
+// mutexes, filas de mensagens, barreiras, task_join e pedidos ao disco. Cada
+// espera com prazo deve retornar -1 depois do prazo, ou 0 se o evento chegar
+// antes; um pedido ao disco só desiste se ainda estiver na fila, e o que o
+// disco já atende é esperado até o fim. No fim, tarefas disputam um semáforo
+// com esperas curtas e nenhuma unidade pode se perder.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+#include "diskdriver.h"
+
+#define NUMDOWNERS 4
+#define NUMUPS     3000
+#define NUMREADERS 4		// tarefas que ocupam o disco
+#define BUSYBLOCK  0		// blocos lidos por elas
+#define TIMEDBLOCK 250		// bloco dos pedidos com prazo
+#define DISKDELAY  50		// tempo minimo de um acesso ao disco, em ms
+
+task_t dona, upper, downer[NUMDOWNERS], chegada, filha, leitor[NUMREADERS] ;
+semaphore_t s, s2 ;
+mutex_t m ;
+mqueue_t fila ;
+barrier_t b ;
+int numBlocks ;			// numero de blocos no disco
+int blockSize ;			// tamanho de cada bloco (bytes)
+int erros = 0 ;
+int ups = 0, downs = 0, fim = 0 ;
+
+void donaBody (void * arg)
+{
+   mutex_lock (&m) ;
+   task_sleep_ms (50) ;
+   mutex_unlock (&m) ;
+   task_exit (0) ;
+}
+
+void upperBody (void * arg)
+{
+   int i ;
+
+   for (i = 0; i < NUMUPS; i++)
+   {
+      sem_up (&s2) ;
+      ups++ ;
+      if (i % 3 == 0)
+         task_sleep_ms (1) ;
+   }
+   fim = 1 ;
+   task_exit (0) ;
+}
+
+void downerBody (void * arg)
+{
+   while (!fim)
+      if (sem_down_timed (&s2, 1) == 0)
+         downs++ ;
+   while (sem_down_try (&s2) == 0)
+      downs++ ;
+   task_exit (0) ;
+}
+
+// chega à barreira depois de alguns ms
+void chegadaBody (void * arg)
+{
+   task_sleep_ms ((long) arg) ;
+   barrier_join (&b) ;
+   task_exit (0) ;
+}
+
+void filhaBody (void * arg)
+{
+   task_sleep_ms (100) ;
+   task_exit (7) ;
+}
+
+// ocupa o disco com a leitura de um bloco
+void leitorBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+
+   disk_block_read (BUSYBLOCK + (long) arg, buffer) ;
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+// cria os leitores e espera que o disco comece a atender o primeiro
+void ocupaDisco ()
+{
+   long i ;
+
+   for (i = 0; i < NUMREADERS; i++)
+      task_create (&leitor[i], leitorBody, (void *) i) ;
+   task_sleep_ms (5) ;
+}
+
+void liberaDisco ()
+{
+   int i ;
+
+   for (i = 0; i < NUMREADERS; i++)
+      task_join (&leitor[i]) ;
+}
+
+int main (int argc, char *argv[])
+{
+   unsigned int inicio, naFila, atendido ;
+   int i, r, msg = 5 ;
+   char *original, *buffer ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   if (diskdriver_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   // semáforo
+   sem_create (&s, 0) ;
+   inicio = systime () ;
+   r = sem_down_timed (&s, 100) ;
+   if (r != -1 || systime () - inicio < 100)
+      erros++ ;
+   if (sem_down_try (&s) != -1)
+      erros++ ;
+   sem_up (&s) ;
+   if (sem_down_try (&s) != 0)
+      erros++ ;
+
+   // mutex: a dona o segura por 50 ms
+   mutex_create (&m) ;
+   task_create (&dona, donaBody, NULL) ;
+   task_yield () ;
+   if (mutex_lock_try (&m) != -1 || mutex_lock_timed (&m, 10) != -1)
+      erros++ ;
+   if (mutex_lock_timed (&m, 500) != 0)
+      erros++ ;
+   mutex_unlock (&m) ;
+   task_join (&dona) ;
+
+   // fila de mensagens com uma vaga
+   mqueue_create (&fila, 1, sizeof(int)) ;
+   inicio = systime () ;
+   r = mqueue_recv_timed (&fila, &msg, 30) ;
+   if (r != -1 || systime () - inicio < 30)
+      erros++ ;
+   if (mqueue_send_try (&fila, &msg) != 0)
+      erros++ ;
+   if (mqueue_send_try (&fila, &msg) != -1 || mqueue_send_timed (&fila, &msg, 30) != -1)
+      erros++ ;
+   if (mqueue_recv_try (&fila, &msg) != 0 || msg != 5 || mqueue_msgs (&fila) != 0)
+      erros++ ;
+   mqueue_destroy (&fila) ;
+
+   // barreira de duas tarefas: quem desiste não conta como chegada
+   barrier_create (&b, 2) ;
+   inicio = systime () ;
+   if (barrier_join_try (&b) != -1 || barrier_join_timed (&b, 30) != -1)
+      erros++ ;
+   if (systime () - inicio < 30)
+      erros++ ;
+   task_create (&chegada, chegadaBody, (void *) 10) ;
+   if (barrier_join_timed (&b, 500) != 0)
+      erros++ ;
+   task_join (&chegada) ;
+   task_create (&chegada, chegadaBody, (void *) 0) ;
+   task_sleep_ms (10) ;
+   if (barrier_join_try (&b) != 0)
+      erros++ ;
+   task_join (&chegada) ;
+   barrier_destroy (&b) ;
+
+   // task_join de uma tarefa que termina depois de 100 ms
+   task_create (&filha, filhaBody, NULL) ;
+   inicio = systime () ;
+   if (task_join_try (&filha) != -1 || task_join_timed (&filha, 30) != -1)
+      erros++ ;
+   if (systime () - inicio < 30)
+      erros++ ;
+   if (task_join_timed (&filha, 500) != 7 || task_join_try (&filha) != 7)
+      erros++ ;
+
+   // disco: sem a cache de blocos, todo pedido vai ao disco; o bloco original
+   // é reescrito, para que o disco não mude
+   disk_cache_size (0) ;
+   original = malloc (blockSize) ;
+   buffer = malloc (blockSize) ;
+   disk_block_read (TIMEDBLOCK, original) ;
+
+   // com o disco ocupado, os pedidos ficam na fila e desistem no prazo
+   ocupaDisco () ;
+   inicio = systime () ;
+   if (disk_block_read_timed (TIMEDBLOCK, buffer, 10) != -1)
+      erros++ ;
+   if (disk_block_write_timed (TIMEDBLOCK, original, 10) != -1)
+      erros++ ;
+   naFila = systime () - inicio ;
+   liberaDisco () ;
+
+   // com o disco livre, o prazo vence com o pedido já em atendimento
+   inicio = systime () ;
+   memset (buffer, 0, blockSize) ;
+   if (disk_block_read_timed (TIMEDBLOCK, buffer, 10) != 0 || memcmp (buffer, original, blockSize))
+      erros++ ;
+   if (disk_block_write_timed (TIMEDBLOCK, original, 10) != 0)
+      erros++ ;
+   atendido = systime () - inicio ;
+   printf ("Disco: pedidos na fila desistiram em %u ms, pedidos atendidos terminaram em %u ms\n",
+           naFila, atendido) ;
+   if (naFila >= DISKDELAY || atendido < 2 * DISKDELAY)
+      erros++ ;
+   free (original) ;
+   free (buffer) ;
+
+   // disputa: cada sem_up deve ser consumido exatamente uma vez
+   sem_create (&s2, 0) ;
+   task_create (&upper, upperBody, NULL) ;
+   for (i = 0; i < NUMDOWNERS; i++)
+      task_create (&downer[i], downerBody, NULL) ;
+   task_join (&upper) ;
+   for (i = 0; i < NUMDOWNERS; i++)
+      task_join (&downer[i]) ;
+   if (downs != ups)
+      erros++ ;
+
+   if (erros == 0)
+      printf ("Esperas com prazo conferidas, %d unidades consumidas, resultado correto!\n", downs) ;
+   else
+      printf ("%d erros nas esperas com prazo, %d de %d unidades consumidas!\n", erros, downs, ups) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
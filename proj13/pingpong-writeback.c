@@ -0,0 +1,148 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da cache de blocos em modo write-back: as escritas das tarefas só
+// atualizam a cache e voltam sem esperar o disco; disk_sync grava os blocos
+// sujos, e depois dele o conteúdo do disco, lido com a cache desativada,
+// deve ser o da última escrita de cada bloco, mesmo de um escrito enquanto
+// uma leitura dele estava no disco. Os blocos usados são restaurados no fim.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pingpong.h"
+#include "diskdriver.h"
+
+#define NUMTASKS  4
+#define NUMBLOCKS 16		// blocos de cada tarefa
+#define NUMROUNDS 3
+#define CACHESIZE 64
+#define DISKDELAY 50		// tempo minimo de um acesso ao disco, em ms
+#define RACEBLOCK 200		// bloco lido e escrito ao mesmo tempo
+
+task_t tarefa[NUMTASKS], leitor ;
+int numBlocks ;			// numero de blocos no disco
+int blockSize ;			// tamanho de cada bloco (bytes)
+char esperado[NUMTASKS * NUMBLOCKS] ;	// conteudo esperado de cada bloco
+int erros = 0 ;
+
+void tarefaBody (void * arg)
+{
+   long myNumber = (long) arg ;
+   char *buffer ;
+   int r, k, block ;
+
+   buffer = malloc (blockSize) ;
+
+   for (r = 0; r < NUMROUNDS; r++)
+      for (k = 0; k < NUMBLOCKS; k++)
+      {
+         block = myNumber * NUMBLOCKS + k ;
+         memset (buffer, 'a' + (block + r) % 26, blockSize) ;
+         if (disk_block_write (block, buffer) < 0)
+            erros++ ;
+         esperado[block] = buffer[0] ;
+      }
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+// lê o bloco RACEBLOCK, que não está na cache
+void leitorBody (void * arg)
+{
+   char *buffer = malloc (blockSize) ;
+
+   if (disk_block_read (RACEBLOCK, buffer) < 0)
+      erros++ ;
+   free (buffer) ;
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   char *original, *buffer, *raceOriginal ;
+   long i ;
+   unsigned int inicio, escrita, sync, vazio, descarte ;
+   int rsync ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   if (diskdriver_init (&numBlocks, &blockSize) < 0)
+   {
+      printf ("Erro na abertura do disco\n") ;
+      exit (1) ;
+   }
+
+   disk_cache_mode (DISK_CACHE_WRITEBACK) ;
+   disk_cache_size (CACHESIZE) ;
+
+   // guarda o conteúdo original dos blocos usados
+   original = malloc (NUMTASKS * NUMBLOCKS * blockSize) ;
+   buffer = malloc (blockSize) ;
+   disk_block_readv (0, NUMTASKS * NUMBLOCKS, original) ;
+   raceOriginal = malloc (blockSize) ;
+   disk_block_read (RACEBLOCK, raceOriginal) ;
+
+   // as escritas cabem na cache e não esperam o disco
+   inicio = systime () ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_create (&tarefa[i], tarefaBody, (void *) i) ;
+   for (i = 0; i < NUMTASKS; i++)
+      task_join (&tarefa[i]) ;
+   escrita = systime () - inicio ;
+
+   // disk_sync grava os blocos sujos; um segundo não tem o que gravar
+   inicio = systime () ;
+   rsync = disk_sync () ;
+   sync = systime () - inicio ;
+   inicio = systime () ;
+   if (disk_sync () < 0)
+      erros++ ;
+   vazio = systime () - inicio ;
+
+   // uma escrita feita enquanto a leitura do mesmo bloco está no disco não
+   // pode ser desfeita pelo conteúdo antigo que a leitura traz
+   task_create (&leitor, leitorBody, NULL) ;
+   task_sleep_ms (10) ;
+   memset (buffer, 'Z', blockSize) ;
+   if (disk_block_write (RACEBLOCK, buffer) < 0)
+      erros++ ;
+   task_join (&leitor) ;
+   if (disk_block_read (RACEBLOCK, buffer) < 0 || buffer[0] != 'Z')
+      erros++ ;
+   if (disk_sync () < 0)
+      erros++ ;
+
+   // sem blocos sujos, desativar a cache não grava nada
+   inicio = systime () ;
+   disk_cache_size (0) ;
+   descarte = systime () - inicio ;
+
+   // o disco deve ter a última escrita de cada bloco
+   for (i = 0; i < NUMTASKS * NUMBLOCKS; i++)
+      if (disk_block_read (i, buffer) < 0 || buffer[0] != esperado[i])
+         erros++ ;
+   if (disk_block_read (RACEBLOCK, buffer) < 0 || buffer[0] != 'Z')
+      erros++ ;
+
+   // restaura o conteúdo original
+   disk_block_writev (0, NUMTASKS * NUMBLOCKS, original) ;
+   disk_block_write (RACEBLOCK, raceOriginal) ;
+   free (original) ;
+   free (raceOriginal) ;
+   free (buffer) ;
+
+   printf ("%d escritas em %u ms, disk_sync em %u ms, sem blocos sujos em %u ms\n",
+           NUMTASKS * NUMBLOCKS * NUMROUNDS, escrita, sync, vazio) ;
+
+   if (erros == 0 && rsync == 0 && escrita < DISKDELAY && vazio < DISKDELAY && descarte < DISKDELAY)
+      printf ("Disco conferido depois do disk_sync, conteudo correto!\n") ;
+   else
+      printf ("%d erros, disk_sync %d, descarte da cache em %u ms!\n", erros, rsync, descarte) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
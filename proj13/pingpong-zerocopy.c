@@ -0,0 +1,96 @@
+// PingPongOS - PingPong Operating System
+//
+// Teste da troca de mensagens sem cópia: o produtor preenche os slots
+// emprestados pela fila com mqueue_alloc e o consumidor os lê no lugar, com
+// mqueue_recv_buf, devolvendo-os com mqueue_release. No fim, confere que a
+// fila recusa slots que não estão no estado esperado.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pingpong.h"
+
+#define NUMMSGS  5000
+#define MSGINTS  1024
+
+task_t prod, cons ;
+mqueue_t fila ;
+int erros = 0 ;
+
+void prodBody (void * arg)
+{
+   int i, *buf ;
+
+   for (i = 0; i < NUMMSGS; i++)
+   {
+      buf = mqueue_alloc (&fila) ;
+      buf[0] = i ;
+      buf[MSGINTS-1] = -i ;
+      mqueue_send_buf (&fila, buf) ;
+      if (i % 3 == 0)
+         task_yield () ;
+   }
+   task_exit (0) ;
+}
+
+void consBody (void * arg)
+{
+   int i, *buf ;
+
+   for (i = 0; i < NUMMSGS; i++)
+   {
+      buf = mqueue_recv_buf (&fila) ;
+      if (buf[0] != i || buf[MSGINTS-1] != -i)
+         erros++ ;
+      if (i % 4 == 0)
+         task_yield () ;
+      mqueue_release (&fila, buf) ;
+   }
+   task_exit (0) ;
+}
+
+int main (int argc, char *argv[])
+{
+   int *buf, outro, recusas ;
+
+   printf ("Main INICIO\n") ;
+
+   pingpong_init () ;
+
+   mqueue_create (&fila, 4, MSGINTS * sizeof(int)) ;
+
+   task_create (&prod, prodBody, NULL) ;
+   task_create (&cons, consBody, NULL) ;
+   task_join (&prod) ;
+   task_join (&cons) ;
+
+   if (erros == 0)
+      printf ("Recebidas %d mensagens, conteudo correto!\n", NUMMSGS) ;
+   else
+      printf ("Recebidas %d mensagens, %d com conteudo errado!\n", NUMMSGS, erros) ;
+
+   // cada uso indevido deve ser recusado com -1
+   recusas = 0 ;
+   recusas += (mqueue_release (&fila, &outro) == -1) ;	// fora da fila
+   buf = mqueue_alloc (&fila) ;
+   recusas += (mqueue_release (&fila, buf + 1) == -1) ;	// no meio de um slot
+   recusas += (mqueue_send_buf (&fila, buf) == 0) ;
+   recusas += (mqueue_send_buf (&fila, buf) == -1) ;	// já enviado
+   recusas += (mqueue_release (&fila, buf) == -1) ;	// enfileirado, não emprestado
+   buf = mqueue_recv_buf (&fila) ;
+   recusas += (mqueue_release (&fila, buf) == 0) ;
+   recusas += (mqueue_release (&fila, buf) == -1) ;	// devolvido duas vezes
+   recusas += (mqueue_send_buf (&fila, buf) == -1) ;	// livre, não emprestado
+
+   if (recusas == 8 && mqueue_msgs (&fila) == 0)
+      printf ("Usos indevidos recusados, resultado correto!\n") ;
+   else
+      printf ("Só %d de 8 verificações passaram, fila com %d mensagens!\n",
+              recusas, mqueue_msgs (&fila)) ;
+
+   mqueue_destroy (&fila) ;
+
+   printf ("Main FIM\n") ;
+   task_exit (0) ;
+
+   exit (0) ;
+}
@@ -3,69 +3,472 @@
 #include <signal.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#ifdef SMP
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#ifdef STACK_MMAP
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 #include "pingpong.h"
 #include "queue.h"
 #include "diskdriver.h"
 #include "harddisk.h"
+#include "context.h"
+
+#ifdef SMP
+/* O ncleo pode usar threads POSIX para implementar os processadores; as aplicaes, no. */
+#undef pthread_create
+#endif
 
 #define STACKSIZE 32768
 
+/* Com STACK_MMAP as pilhas so reservadas com mmap e s ocupam memria conforme so tocadas, ento o
+ * padro pode ser uma faixa grande de endereos. */
+#ifdef STACK_MMAP
+#define DEFAULT_STACKSIZE 1048576
+#else
+#define DEFAULT_STACKSIZE STACKSIZE
+#endif
+
 #define DEFAULT_PRIO 0
 #define MIN_PRIO -20
 #define MAX_PRIO 20
 #define ALPHA_PRIO 1
+#define NUM_PRIO (MAX_PRIO - MIN_PRIO + 1)
+
+#define SLEEP_HEAP_INITIAL 16
+
+/* Estados de um slot de fila de mensagens */
+#define MQUEUE_SLOT_FREE 0 // na pilha de slots livres
+#define MQUEUE_SLOT_BORROWED 1 // com uma tarefa (mqueue_alloc ou mqueue_recv_buf)
+#define MQUEUE_SLOT_QUEUED 2 // no buffer circular, esperando mqueue_recv
+
+#define STACK_CLASSES 4
+#define STACK_POOL_MAX 256 // Mximo de pilhas livres guardadas em cada classe
 
 #define RESET_TICKS 10
 #define TICK_MICROSECONDS 1000
 
+/* Poltica de escalonamento do disco usada por diskdriver_init: a ordem de chegada. As outras so
+ * escolhidas com diskdriver_init_sched. */
+#define DISK_SCHED DISK_SCHED_FCFS
+
+/* Capacidade inicial da cache de blocos do disco, em blocos */
+#ifndef DISK_CACHE_BLOCKS
+#define DISK_CACHE_BLOCKS 64
+#endif
+
+/* Modo de escrita inicial da cache de blocos; write-back pode ser escolhido com -DDISK_CACHE_MODE=... ou
+ * com disk_cache_mode */
+#ifndef DISK_CACHE_MODE
+#define DISK_CACHE_MODE DISK_CACHE_WRITETHROUGH
+#endif
+
+/* Tempo que a tarefa de gravao espera para juntar escritas num lote, em ms */
+#define DISK_FLUSH_MS 500
+
+/* Mximo de blocos contguos que a tarefa de gravao leva ao disco num s pedido */
+#define DISK_FLUSH_RUN 16
+
+/* Janela da leitura antecipada, em blocos: comea em READAHEAD_MIN quando um fluxo sequencial 
+ * detectado e dobra (at READAHEAD_MAX) enquanto os blocos antecipados so usados */
+#define READAHEAD_MIN 2
+#ifndef READAHEAD_MAX
+#define READAHEAD_MAX 16
+#endif
+
+#ifdef SMP
+#define MAX_CORES 64
+#define MUTEX_SPIN_LIMIT 2000 // Voltas de espera ativa por um mutex cuja dona est executando
+#else
+#define MAX_CORES 1
+#endif
+
+/* Ids das tarefas do ncleo criadas por kernel_task_create: KERNEL_TID_FIRST, KERNEL_TID_FIRST - 1, ...
+ * A faixa fica abaixo dos ids dos dispatchers dos ncleos secundrios (-1 a -(MAX_CORES - 1)). */
+#define KERNEL_TID_FIRST (-MAX_CORES - 1000)
+
+// Estado de cada ncleo (processador virtual). Sem SMP h um s ncleo.
+typedef struct core_t {
+    int id;
+
+    task_t taskDisp; // Dispatcher do ncleo
+    task_t* taskExec; // Task em execuo
+    task_t* freeTask; // Task a ser liberada (exit)
+
+    task_t* readyQueue[NUM_PRIO]; // Filas de tarefas prontas, uma por prioridade esttica
+    unsigned long long readyBitmap; // Bit i ligado indica que readyQueue[i] no est vazia
+    unsigned int readyEpoch; // Contagem de escalonamentos, usada no envelhecimento das tarefas prontas
+    int readyCount; // Nmero de tarefas prontas no ncleo que podem migrar (sem afinidade)
+
+    short remainingTicks;
+    volatile unsigned char needResched; // quantum esgotado dentro de uma seo crtica: troca na sada dela
+
+#ifdef CTX_ASM
+    unsigned char alarmMasked; // SIGALRM bloqueado por uma troca de contexto feita dentro do tratador de ticks
+#endif
+
+#ifdef SMP
+    pthread_t thread;
+    timer_t tickTimer;
+#endif
+} core_t;
+
+core_t cores[MAX_CORES];
+int numCores;
+
 // Tasks
 task_t taskMain; // Main
-task_t taskDisp; // Dispatcher
 task_t taskDiskMgr; // Gerenciador de disco
-
-// Ponteiros para tasks
-task_t* taskExec; // Task em execuo
-task_t* freeTask; // Task a ser liberada (exit)
+task_t taskDiskFlusher; // Gravao dos blocos sujos da cache do disco
 
 // Filas
-task_t* readyQueue; // Fila de tarefas prontas
-task_t* sleepQueue; // Fila de tarefas dormindo
 task_t* suspendedQueue; // Fila de tarefas suspensas (por tempo indeterminado)
 
+/* Tarefas dormindo: heap mnimo ordenado por awakeTime (e, no empate, pela ordem de entrada), cuja
+ * raiz  a prxima a acordar */
+task_t** sleepHeap;
+int sleepCount;
+int sleepCapacity;
+unsigned int sleepSeqNext; // prximo nmero de ordem dado a uma tarefa que entra no heap
+
+/* Pool de pilhas: uma lista de pilhas livres para cada classe de tamanho. O ponteiro para a prxima
+ * pilha da lista fica na ltima palavra (topo) da prpria pilha livre, que  a primeira pgina a ser
+ * usada quando a pilha for reaproveitada. */
+const int stackClassSize[STACK_CLASSES] = { 16384, STACKSIZE, 131072, 1048576 };
+void* stackPool[STACK_CLASSES];
+int stackPoolCount[STACK_CLASSES];
+long stackHits; // Pilhas obtidas do pool
+long stackMisses; // Pilhas alocadas com malloc (ou mmap)
+#define STACK_LINK(stack, size) (*(void**)((char*)(stack) + (size) - sizeof(void*)))
+
+#ifdef STACK_MMAP
+long pageSize;
+#endif
+
 /* ID da prxima task a ser criada */
 long nextid;
 
 /* Contagem de tasks de usurio criadas */
 long countTasks;
 
-/* Flag que indica se a preempcao por tempo esta ativa ou nao */
-unsigned char preempcao;
+/* ID da prxima task do ncleo (kernel_task_create) */
+long nextKernelTid;
 
 /* Preempo por tempo */
-void tickHandler();
-short remainingTicks;
+void tickHandler(int signum, siginfo_t* info, void* context);
 struct sigaction action;
 struct itimerval timer;
 unsigned int systemTime;
 
+/* Preempta a tarefa corrente, a partir do tratador de ticks. */
+void task_preempt();
+
+/* Sees crticas do ncleo. Cada tarefa conta em preemptCount quantas sees aninhadas abriu;
+ * com o contador > 0 o tratador de ticks no a preempta, s marca needResched no ncleo, e a troca
+ *  feita por kernel_unlock quando o contador volta a 0. Com SMP a seo tambm adquire a trava
+ * global do ncleo. */
+void kernel_lock();
+void kernel_unlock();
+#define KERNEL_LOCK() kernel_lock()
+#define KERNEL_UNLOCK() kernel_unlock()
+
+#ifdef CTX_ASM
+/* Mscara contendo apenas o SIGALRM */
+sigset_t alarmMask;
+#endif
+
+#ifdef SMP
+/* Ncleo associado a cada thread. */
+__thread core_t* currentCore;
+
+/* Retorna o ncleo em que o cdigo corrente est executando. */
+core_t* this_core() __attribute__((noinline, noipa));
+
+/* Trava global do ncleo (big kernel lock). Fica com o processador, e no com a tarefa: quem troca
+ * de contexto com ela adquirida a entrega para a tarefa que assume o processador, que a libera. */
+volatile int kernelLock;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax()
+#endif
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* Funo executada pelas threads dos ncleos secundrios. */
+void* core_main(void* arg);
+
+/* Cria o temporizador de ticks do ncleo corrente, que gera SIGALRM apenas para a sua thread. */
+void core_timer_start(core_t* c);
+
+/* Retira uma tarefa pronta do ncleo mais carregado. */
+task_t* steal_task(core_t* c);
+
+/* Indica se a tarefa interrompida pode ser preemptada (no est dentro da libc). */
+int preempt_safe(void* context);
+#else
+#define this_core() (&cores[0])
+#endif
+
+/* Ponto de entrada das tarefas criadas por task_create. */
+void task_start(task_t* task);
+
+/* Prepara a tarefa com o id indicado e a coloca na fila de prontas. Deve ser chamada na seo crtica.
+ * Retorna 0, ou -1 se no h memria para a pilha. */
+int task_init(task_t* task, void(*start_func)(void*), void* arg, const task_attr_t* attr, int tid);
+
+/* Cria uma tarefa do ncleo, como a de gravao do disco: ela recebe um id da faixa KERNEL_TID_FIRST,
+ * no conta como tarefa de usurio e no consome ids de task_create. Retorna 0, ou -1 em erro. */
+int kernel_task_create(task_t* task, void(*start_func)(void*), void* arg);
+
 /* Funo a ser executada pela task do dispatcher*/
 void bodyDispatcher(void* arg);
 
+/* Lao do dispatcher do ncleo corrente. */
+void dispatcher_loop();
+
+/* Bloqueia o processo at que alguma tarefa possa ficar pronta (tickless idle). */
+void dispatcher_idle();
+
+/* Acorda as tarefas cujo evento j ocorreu: fim do sono ou sinal do disco. */
+void dispatcher_wakeup();
+
+/* Libera a pilha (e o descritor, se do ncleo) da ltima tarefa encerrada no ncleo. */
+void dispatcher_release(core_t* c);
+
 /* Funo a ser executada pelo gerenciador de disco */
 void bodyDiskManager(void* arg);
+
+/* Conclui os pedidos do lote em atendimento (disco.current), com erro se failed, e libera o disco. */
+void disk_complete(int failed);
 disk_t disco;
 struct sigaction diskAction;
 void diskSignalHandler();
 
-/* Funo que retorna a prxima task a ser executada. */
-task_t* scheduler();
+/* Escolhe, conforme a poltica do disco, o prximo pedido da fila a ser atendido (sem retir-lo). */
+diskrequest_t* disk_sched_next();
+
+/* Indica se um pedido mais antigo da fila usa algum bloco do pedido e um dos dois  uma escrita:
+ * nesse caso o mais antigo precisa ser atendido antes. */
+int disk_request_blocked(diskrequest_t* request, diskrequest_t* queue);
+
+/* Junta ao pedido (j retirado da fila) os pedidos da mesma fila com a mesma operao cujos blocos
+ * continuam a sequncia, antes ou depois, at DISK_IOV_MAX trechos. Os pedidos juntados ficam
+ * ligados por batchNext em ordem crescente de bloco, e iov recebe um trecho por pedido. Retorna o
+ * primeiro pedido da sequncia e, em iovcnt, o nmero de trechos. */
+diskrequest_t* disk_merge(diskrequest_t* request, diskrequest_t** queue, disk_iovec_t* iov, int* iovcnt);
+
+/* Cache de blocos do disco: cache_lookup procura um bloco e o torna o mais recentemente usado
+ * (cache_find s procura),
+ * cache_insert guarda (ou atualiza) uma cpia dele, reaproveitando a entrada limpa menos
+ * recentemente usada se a cache estiver cheia (retorna a entrada, ou NULL se todas estiverem sujas
+ * ou sendo gravadas), e cache_invalidate descarta a cpia, se houver. cache_fill guarda o contedo
+ * lido do disco s se a cpia na cache no tiver uma escrita adiada mais nova. */
+cacheblock_t* cache_lookup(int block);
+cacheblock_t* cache_find(int block);
+cacheblock_t* cache_insert(int block, void* data);
+cacheblock_t* cache_fill(int block, void* data);
+void cache_invalidate(int block);
+
+/* Marca como sujo um bloco alterado na cache em write-back, acordando a tarefa de gravao pela
+ * primeira escrita adiada e quando a cache fica com muitos blocos sujos. */
+void cache_dirty(cacheblock_t* entry);
+
+/* Indica se h uma escrita do bloco na fila do disco ou em andamento. */
+int disk_write_pending(int block);
+
+/* Tarefa de gravao (write-back): espera blocos sujos, d um tempo para juntar mais escritas e os
+ * grava em lote. disk_flush_wake a acorda. */
+void bodyDiskFlusher(void* arg);
+void disk_flush_wake();
+
+/* Indica se ainda h blocos da cache a levar ao disco: sujos ou numa gravao em andamento. */
+int disk_flush_pending();
+
+/* Grava no disco os blocos sujos da cache, em ordem crescente de bloco. Deve ser chamada com
+ * flushLock. Retorna 0, ou -1 se alguma escrita falhou (e o bloco continua sujo). */
+int disk_flush();
+int cache_block_cmp(const void* a, const void* b);
+
+/* Leitura antecipada: disk_readahead acompanha os fluxos sequenciais da tarefa com a leitura de count
+ * blocos a partir de block (useful indica se algum veio de uma leitura antecipada), ajusta a janela
+ * do fluxo e pede os prximos blocos; disk_prefetch enfileira a leitura antecipada de um bloco, disk_prefetch_find a
+ * procura (com promote, se ela ainda no comeou, passa a ter a prioridade de um pedido normal) e
+ * disk_prefetch_done a conclui, guardando o bloco na cache. */
+void disk_readahead(task_t* task, int block, int count, int useful);
+void disk_prefetch(int block);
+diskrequest_t* disk_prefetch_find(int block, int promote);
+void disk_prefetch_done(diskrequest_t* request);
+
+/* Funo que retorna a prxima task a ser executada no ncleo c, retirando-a da fila de prontas.
+ * Com migrating, ignora as tarefas presas ao ncleo c (roubo de tarefas). */
+task_t* scheduler(core_t* c, int migrating);
+
+/* Operaes sobre as filas de prontas */
+void ready_append(task_t* task);
+void ready_remove(task_t* task);
+int ready_contains(task_t* task);
+
+/* Devolve  fila de prontas do seu ncleo uma tarefa que acabou de sair dela (ao mudar de prioridade),
+ * mantendo readyEpoch: ela entra antes das que ficaram prontas depois dela, sem perder o envelhecimento. */
+void ready_reinsert(task_t* task);
+
+/* Herana de prioridade: task_prio_set muda a prioridade efetiva (reposicionando a tarefa se ela
+ * estiver pronta), task_prio_update a recalcula a partir de basePrio e de quem espera pelos mutexes
+ * da tarefa, task_prio_boost eleva a prioridade de uma dona (e das donas de quem ela espera) e
+ * task_prio_unwind a recalcula quando uma tarefa deixa de esperar, seguindo a mesma cadeia. */
+void task_prio_set(task_t* task, int prio);
+void task_prio_update(task_t* task);
+void task_prio_boost(task_t* task, int prio);
+void task_prio_unwind(task_t* task);
+
+/* Tarefa de maior prioridade (a mais antiga entre as iguais) na fila do mutex, ou NULL. */
+task_t* mutex_top_waiter(mutex_t* m);
+
+/* Tira o mutex da lista de mutexes detidos por sua dona. */
+void mutex_held_remove(mutex_t* m);
+
+/* Entrega o mutex  tarefa indicada, que passa a ser a sua dona. */
+void mutex_give(mutex_t* m, task_t* task);
+
+/* Libera o mutex da dona atual, passando-o para a tarefa mais prioritria da fila, se houver;
+ * retorna essa tarefa, ou NULL. Deve ser chamada com a trava do ncleo. */
+task_t* mutex_release(mutex_t* m);
+
+/* Acorda uma tarefa que espera numa varivel de condio: se o mutex estiver ocupado, a tarefa vai
+ * direto para a fila dele, sem acordar; seno, recebe o mutex e vai para a fila de prontas. */
+void cond_wake(cond_t* c, task_t* task);
+
+/* Registro da tarefa entre os leitores da trava rw, ou NULL; com create, se no houver, cria um com
+ * contagem zero (NULL se faltar memria). rwlock_read_release o descarta quando a contagem zera. */
+readhold_t* rwlock_read_hold(task_t* task, rwlock_t* rw, int create);
+void rwlock_read_release(rwlock_t* rw, readhold_t* hold);
+
+/* Retira uma task da fila em que ela estiver, seja ela de prontas ou no. */
+void task_unqueue(task_t* task);
+
+/* Suspende a tarefa corrente na fila queue e troca de tarefa; com ms >= 0, ela tambm entra no heap
+ * de tarefas dormindo e  acordada ao fim do prazo. Deve ser chamada com a trava do ncleo.
+ * Retorna 0 se a tarefa foi acordada pelo evento, ou -1 se o prazo venceu (j fora da fila). */
+int task_block(task_t** queue, int ms);
+
+/* Implementaes das operaes bloqueantes, com prazo ms: < 0 espera sem prazo, 0 no bloqueia,
+ * > 0 desiste depois de ms milissegundos. */
+int task_join_wait(task_t* task, int ms);
+int sem_down_wait(semaphore_t* s, int ms);
+int mutex_lock_wait(mutex_t* m, int ms);
+int barrier_join_wait(barrier_t* b, int ms);
+int mqueue_send_wait(mqueue_t* queue, void* msg, int ms);
+int mqueue_recv_wait(mqueue_t* queue, void* msg, int ms);
+void* mqueue_alloc_wait(mqueue_t* queue, int ms);
+void* mqueue_recv_buf_wait(mqueue_t* queue, int ms);
+int disk_request(unsigned char operation, int block, void* buffer, int ms);
+
+/* Leitura e escrita de count blocos consecutivos: cada bloco  atendido pela cache, se possvel,
+ * e os demais vo ao disco em trechos contguos, um pedido por trecho. */
+int disk_request_v(unsigned char operation, int block, int count, void* buffer);
+
+/* Envia um pedido de count blocos ao gerenciador de disco e espera o seu fim, sem passar pela
+ * cache; disk_io_cached depois atualiza a cache com o resultado. */
+int disk_io(unsigned char operation, int block, int count, void* buffer, int ms);
+int disk_io_cached(unsigned char operation, int block, int count, void* buffer, int ms);
+
+/* Se o bloco est sendo lido antecipadamente (na fila ou no disco), promove essa leitura e a espera,
+ * em vez de repeti-la. *ms  o prazo que resta at deadline, atualizado a cada espera. Retorna 1 se
+ * esperou, 0 se no havia leitura antecipada do bloco, ou -1 se o prazo venceu. */
+int disk_prefetch_wait(int block, int* ms, unsigned int deadline);
+
+/* Operaes sobre o pool de pilhas */
+int stack_class(int size);
+void* stack_alloc(int* size);
+void stack_free(void* stack, int size);
+void* stack_new(int size);
+void stack_delete(void* stack, int size);
+int stack_highwater(task_t* task);
+
+/* Operaes em lote sobre semforos: sem_down_upto obtm entre 1 e n unidades (bloqueando s se no
+ * houver nenhuma) e retorna quantas obteve; sem_up_n devolve n unidades de uma vez. */
+int sem_down_upto(semaphore_t* s, int n);
+int sem_up_n(semaphore_t* s, int n);
+
+/* Fila de mensagens SPSC: lado 0  o remetente (espera vaga), lado 1 o destinatrio (espera mensagem). */
+int mqueue_spsc_count(mqueue_t* queue);
+int mqueue_spsc_send(mqueue_t* queue, void* msg, int ms);
+int mqueue_spsc_recv(mqueue_t* queue, void* msg, int ms);
+int mqueue_spsc_wait(mqueue_t* queue, int side, int ms);
+void mqueue_spsc_wake(mqueue_t* queue, int side);
+
+/* Slots da fila de mensagens: mqueue_slot retorna o ndice do slot buf (dentro de content e alinhado a
+ * messageSize), ou -1. mqueue_slot_take tira um slot da pilha de livres e mqueue_slot_put o devolve;
+ * mqueue_ring_put enfileira um slot no buffer circular e mqueue_ring_get retira o mais antigo. Devem
+ * ser chamadas com sBuffer. */
+int mqueue_slot(mqueue_t* queue, void* buf);
+void* mqueue_slot_take(mqueue_t* queue, unsigned char state);
+void mqueue_slot_put(mqueue_t* queue, void* buf);
+void mqueue_ring_put(mqueue_t* queue, void* buf);
+void* mqueue_ring_get(mqueue_t* queue, unsigned char state);
+
+/* Operaes sobre o heap de tarefas dormindo */
+int sleep_insert(task_t* task);
+void sleep_remove(task_t* task);
+void sleep_siftup(int i);
+void sleep_siftdown(int i);
+
+/* Diz se a tarefa a deve acordar antes de b: prazo menor ou, com o mesmo prazo, entrada mais antiga. */
+int sleep_before(task_t* a, task_t* b);
 
 void pingpong_init() {
+    int i;
+
     /* Desativa o buffer de sada padro */
     setvbuf(stdout, 0, _IONBF, 0);
 
-    readyQueue = NULL;
-    sleepQueue = NULL;
+    /* Ncleos */
+#ifdef SMP
+#ifdef NUM_CORES
+    numCores = NUM_CORES;
+#else
+    numCores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (numCores < 1) {
+        numCores = 1;
+    }
+    if (numCores > MAX_CORES) {
+        numCores = MAX_CORES;
+    }
+#else
+    numCores = 1;
+#endif
+    memset(cores, 0, sizeof(cores));
+    for (i = 0; i < numCores; i++) {
+        cores[i].id = i;
+        cores[i].remainingTicks = RESET_TICKS;
+    }
+#ifdef SMP
+    currentCore = &cores[0];
+#endif
+
+    sleepHeap = NULL;
+    sleepCount = 0;
+    sleepCapacity = 0;
+    memset(stackPool, 0, sizeof(stackPool));
+    memset(stackPoolCount, 0, sizeof(stackPoolCount));
+    stackHits = 0;
+    stackMisses = 0;
+#ifdef STACK_MMAP
+    pageSize = sysconf(_SC_PAGESIZE);
+#endif
 
     /* INICIA A TASK MAIN */
     /* Referncia a si mesmo */
@@ -83,33 +486,44 @@ void pingpong_init() {
     taskMain.execTime = 0;
     taskMain.procTime = 0;
     taskMain.activations = 0;
-    preempcao = 1;
 
     taskMain.joinQueue = NULL;
 
     taskMain.awakeTime = 0;
+    taskMain.sleepIndex = -1;
+    taskMain.timedOut = 0;
+
+    taskMain.affinity = -1;
+    strcpy(taskMain.name, "main");
 
     /* Coloca a tarefa na fila */
-    queue_append((queue_t**)&readyQueue, (queue_t*)&taskMain);
-    taskMain.queue = &readyQueue;
+    taskMain.prio = DEFAULT_PRIO;
+    taskMain.basePrio = taskMain.prio;
+    taskMain.dynPrio = taskMain.prio;
+    taskMain.heldMutexes = NULL;
+    taskMain.blockedOn = NULL;
+    for (i = 0; i < READ_STREAMS; i++) {
+        taskMain.readStreams[i].last = -2;
+    }
+    ready_append(&taskMain);
 
     /* O id da prxima task a ser criada  1. */
     nextid = 1;
     
     /* A contagem de tasks de usurio inicia em 0. */
     countTasks = 0;
+    nextKernelTid = KERNEL_TID_FIRST;
 
     /* A task que est executando nesse momento  a main (que chamou pingpong_init). */
-    taskExec = &taskMain;
+    cores[0].taskExec = &taskMain;
 
     /* Nao ha nenhuma task para ser liberada. */
-    freeTask = NULL;
+    cores[0].freeTask = NULL;
 
     /* Preempo por tempo */
-    remainingTicks = RESET_TICKS;
-    action.sa_handler = tickHandler;
+    action.sa_sigaction = tickHandler;
     sigemptyset(&action.sa_mask);
-    action.sa_flags = 0;
+    action.sa_flags = SA_SIGINFO;
     if (sigaction(SIGALRM, &action, 0) < 0) {
         perror("Erro em sigaction: ");
         exit(1);
@@ -118,18 +532,26 @@ void pingpong_init() {
     timer.it_value.tv_sec = 0;
     timer.it_interval.tv_usec = TICK_MICROSECONDS;
     timer.it_interval.tv_sec = 0;
+#ifdef CTX_ASM
+    sigemptyset(&alarmMask);
+    sigaddset(&alarmMask, SIGALRM);
+#endif
+#ifdef SMP
+    core_timer_start(&cores[0]);
+#else
     if (setitimer(ITIMER_REAL, &timer, 0) < 0) {
         perror("Erro em setitimer: ");
         exit(1);
     }
+#endif
 
     systemTime = 0;
 
     /* O contexto no precisa ser salvo agora, porque a primeira troca de contexto far isso. */
 
     /* INICIA A TASK DISPATCHER */
-    task_create(&taskDisp, &bodyDispatcher, NULL);
-    queue_remove((queue_t**)&readyQueue, (queue_t*)&taskDisp);
+    task_create(&cores[0].taskDisp, &bodyDispatcher, NULL);
+    ready_remove(&cores[0].taskDisp);
 
     /* INICIA A TASK DISK MANAGER */
     task_create(&taskDiskMgr, &bodyDiskManager, NULL);
@@ -142,21 +564,117 @@ void pingpong_init() {
         exit(1);
     }
 
+    /* A task main est na fila de prontas, mas seu contexto s  salvo na primeira troca de contexto:
+     * os outros ncleos no podem escalon-la antes disso. */
+    KERNEL_LOCK();
+
+#ifdef SMP
+    /* INICIA OS NCLEOS SECUNDRIOS */
+    for (i = 1; i < numCores; i++) {
+        if (pthread_create(&cores[i].thread, NULL, core_main, &cores[i]) != 0) {
+            perror("Erro na criao dos ncleos: ");
+            exit(1);
+        }
+    }
+#endif
+
     /* Ativa o dispatcher */
     task_yield();
+
+    KERNEL_UNLOCK();
 }
 
 int task_create(task_t* task, void(*start_func)(void*), void* arg) {
+    return task_create_ex(task, start_func, arg, NULL);
+}
+
+int task_create_stack(task_t* task, void(*start_func)(void*), void* arg, int stacksize) {
+    task_attr_t attr;
+
+    task_attr_init(&attr);
+    attr.stacksize = stacksize;
+
+    return task_create_ex(task, start_func, arg, &attr);
+}
+
+void task_attr_init(task_attr_t* attr) {
+    attr->stacksize = DEFAULT_STACKSIZE;
+    attr->prio = DEFAULT_PRIO;
+    attr->affinity = -1;
+    attr->name = NULL;
+    attr->detached = 0;
+}
+
+int task_create_ex(task_t* task, void(*start_func)(void*), void* arg, const task_attr_t* attr) {
+    task_attr_t defaults;
+    int tid;
+    unsigned char kernelOwned;
+
+    if (attr == NULL) {
+        task_attr_init(&defaults);
+        attr = &defaults;
+    }
+
+    if (attr->prio > MAX_PRIO || attr->prio < MIN_PRIO || attr->affinity < -1 || attr->affinity >= numCores) {
+        return -1;
+    }
+
+    /* S tarefas desvinculadas podem ter o descritor alocado pelo ncleo: ningum o referencia depois. */
+    if (task == NULL && !attr->detached) {
+        return -1;
+    }
+
+    KERNEL_LOCK();
+
+    kernelOwned = 0;
+    if (task == NULL) {
+        task = malloc(sizeof(task_t));
+        if (task == NULL) {
+            perror("Erro na criao do descritor: ");
+            KERNEL_UNLOCK();
+            return -1;
+        }
+        memset(task, 0, sizeof(task_t));
+        kernelOwned = 1;
+    }
+
+    if (task_init(task, start_func, arg, attr, nextid) < 0) {
+        if (kernelOwned) {
+            free(task);
+        }
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    task->kernelOwned = kernelOwned;
+    nextid++;
+    countTasks++;
+
+    /* Ao sair da seo crtica a tarefa pode executar e, se desvinculada, terminar e ser liberada. */
+    tid = task->tid;
+    KERNEL_UNLOCK();
+    return tid;
+}
+
+int task_init(task_t* task, void(*start_func)(void*), void* arg, const task_attr_t* attr, int tid) {
     char* stack;
+    int stacksize;
+    int i;
+
+    stacksize = attr->stacksize;
+    if (stacksize <= 0) {
+        stacksize = DEFAULT_STACKSIZE;
+    }
 
     /* Coloca referncia para task main. */
     task->main = &taskMain;
 
+#ifndef CTX_ASM
     /* Inicializa o contexto. */
     getcontext(&(task->context));
+#endif
 
-    /* Aloca a pilha. */
-    stack = malloc(STACKSIZE);
+    /* Aloca a pilha. O tamanho  arredondado para a classe do pool. */
+    stack = stack_alloc(&stacksize);
     if (stack == NULL) {
         perror("Erro na criao da pilha: ");
         return -1;
@@ -164,27 +682,51 @@ int task_create(task_t* task, void(*start_func)(void*), void* arg) {
 
     /* Seta a pilha do contexto. */
     task->context.uc_stack.ss_sp = stack;
-    task->context.uc_stack.ss_size = STACKSIZE;
+    task->context.uc_stack.ss_size = stacksize;
     task->context.uc_stack.ss_flags = 0;
 
     /* No liga o contexto a outro. */
     task->context.uc_link = NULL;
 
-    /* Cria o contexto com a funo. */
-    makecontext(&(task->context), (void(*)(void))start_func, 1, arg);
+    /* Cria o contexto, que comea em task_start e chama a funo. */
+    task->startFunc = start_func;
+    task->startArg = arg;
+#ifdef CTX_ASM
+    task->sp = ctx_init(stack, stacksize, (void(*)(void*))task_start, task);
+#else
+    makecontext(&(task->context), (void(*)(void))task_start, 1, task);
+#endif
+    task->preempted = 0;
+
+    /* A tarefa comea a executar dentro da seo crtica de quem trocou para ela; task_start a encerra. */
+    task->preemptCount = 1;
 
     /* Seta o id da task. */
-    task->tid = nextid;
-    nextid++;
-    
-    countTasks++;
+    task->tid = tid;
+
+    /* Atributos */
+    task->affinity = attr->affinity;
+    task->detached = attr->detached;
+    task->kernelOwned = 0;
+    task->name[0] = '\0';
+    if (attr->name != NULL) {
+        strncpy(task->name, attr->name, TASK_NAME_SIZE - 1);
+        task->name[TASK_NAME_SIZE - 1] = '\0';
+    }
 
     /* Informaes da fila. */
-    queue_append((queue_t**)&readyQueue, (queue_t*)task);
-    task->queue = &readyQueue;
-    task->estado = 'r';
-    task->prio = DEFAULT_PRIO;
+    task->queue = NULL;
+    task->core = NULL;
+    task->prio = attr->prio;
+    task->basePrio = task->prio;
     task->dynPrio = task->prio;
+    task->heldMutexes = NULL;
+    task->blockedOn = NULL;
+    ready_append(task);
+
+#ifdef DEBUG
+    printf("task_create: criada a tarefa %d (%s)\n", task->tid, task->name);
+#endif
 
     /* Informaes de tempo */
     task->creationTime = systime();
@@ -196,691 +738,3462 @@ int task_create(task_t* task, void(*start_func)(void*), void* arg) {
     task->joinQueue = NULL;
 
     task->awakeTime = 0;
+    task->sleepIndex = -1;
+    task->timedOut = 0;
+
+    task->stackHighWater = -1;
+
+    memset(task->readStreams, 0, sizeof(task->readStreams));
+    for (i = 0; i < READ_STREAMS; i++) {
+        task->readStreams[i].last = -2; // Nenhum bloco  vizinho do ltimo.
+    }
+
+    return 0;
+}
+
+int kernel_task_create(task_t* task, void(*start_func)(void*), void* arg) {
+    task_attr_t attr;
+
+    task_attr_init(&attr);
+
+    KERNEL_LOCK();
+    if (task_init(task, start_func, arg, &attr, nextKernelTid) < 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    nextKernelTid--;
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+void task_start(task_t* task) {
+    /* A tarefa  ativada por um task_yield ou pelo dispatcher, que impedem a preempo durante a troca. */
+    KERNEL_UNLOCK();
 
-    return (task->tid);
+    task->startFunc(task->startArg);
+
+    /* Se a funo da tarefa retornar, encerra a tarefa. */
+    task_exit(0);
 }
 
 void task_exit(int exitCode) {
-    freeTask = taskExec;
-    freeTask->estado = 'x';
-    freeTask->exitCode = exitCode;
+    core_t* c;
+
+    KERNEL_LOCK();
+    c = this_core();
+
+    /* A tarefa no volta mais a executar: sai da seo crtica s ao trocar para o dispatcher. */
+
+    c->freeTask = c->taskExec;
+    c->freeTask->estado = 'x';
+    c->freeTask->exitCode = exitCode;
 
     /* Acorda todas as tarefas na fila de join. */
-    while (freeTask->joinQueue != NULL) {
-        task_resume(freeTask->joinQueue);
+    while (c->freeTask->joinQueue != NULL) {
+        task_resume(c->freeTask->joinQueue);
     }
 
-    freeTask->procTime += systime() - freeTask->lastExecutionTime;
-    freeTask->execTime = systime() - freeTask->creationTime;
-    printf("Task %d exit: execution time %d ms, processor time %d ms, %d activations\n", freeTask->tid, freeTask->execTime, freeTask->procTime, freeTask->activations);
+    /* Registra o uso mximo da pilha antes que ela volte para o pool. */
+    c->freeTask->stackHighWater = stack_highwater(c->freeTask);
+
+    c->freeTask->procTime += systime() - c->freeTask->lastExecutionTime;
+    c->freeTask->execTime = systime() - c->freeTask->creationTime;
+    printf("Task %d exit: execution time %d ms, processor time %d ms, %d activations\n", c->freeTask->tid, c->freeTask->execTime, c->freeTask->procTime, c->freeTask->activations);
     
     countTasks--;
 
-    if (taskExec == &taskDisp) {
+    if (c->taskExec == &c->taskDisp) {
         task_switch(&taskMain);
     }
     else {
-        task_switch(&taskDisp);
+        task_switch(&c->taskDisp);
     }
+
+    KERNEL_UNLOCK();
 }
 
 int task_switch(task_t *task) {
+    core_t* c;
     task_t* prevTask;
 
-    prevTask = taskExec;
-    taskExec = task;
+    KERNEL_LOCK();
+    c = this_core();
+
+    prevTask = c->taskExec;
+    c->taskExec = task;
 
     prevTask->procTime += systime() - prevTask->lastExecutionTime;
 
     task->activations++;
     task->lastExecutionTime = systime();
 
+#ifdef CTX_ASM
+    /* Sem o swapcontext, a mscara de sinais no acompanha a tarefa. Uma troca feita dentro do
+     * tratador de ticks deixa o SIGALRM bloqueado: ele  liberado antes de retomar uma tarefa que
+     * saiu do processador voluntariamente. Uma tarefa preemptada volta para dentro do tratador, e
+     * o retorno do tratador restaura a sua mscara. */
+    if (c->alarmMasked && !task->preempted) {
+        sigprocmask(SIG_UNBLOCK, &alarmMask, NULL);
+        c->alarmMasked = 0;
+    }
+
+    ctx_switch(&prevTask->sp, task->sp);
+#else
     if (swapcontext(&(prevTask->context), &(task->context)) < 0) {
         perror("Erro na troca de contexto: ");
-        taskExec = prevTask;
+        c->taskExec = prevTask;
+        KERNEL_UNLOCK();
         return -1;
     }
+#endif
 
+    KERNEL_UNLOCK();
     return 0;
 }
 
+const char* task_getname(task_t* task) {
+    const char* name;
+
+    KERNEL_LOCK();
+    if (task == NULL) {
+        task = this_core()->taskExec;
+    }
+    name = task->name;
+    KERNEL_UNLOCK();
+
+    return name;
+}
+
 int task_id() {
-    return (taskExec->tid);
+    int tid;
+
+    KERNEL_LOCK();
+    tid = this_core()->taskExec->tid;
+    KERNEL_UNLOCK();
+
+    return tid;
 }
 
 void task_suspend(task_t *task, task_t **queue) {
+    KERNEL_LOCK();
+
     /* Se task for nulo, considera a tarefa corrente. */
     if (task == NULL) {
-        task = taskExec;
+        task = this_core()->taskExec;
     }
 
     /* Se queue for nulo, no retira a tarefa da fila atual. */
     if (queue != NULL) {
-        if (task->queue != NULL) {
-            queue_remove((queue_t**)(task->queue), (queue_t*)task);
-        }
-        queue_append((queue_t**)queue, (queue_t*)task);
-        task->queue = queue;
+        task_unqueue(task);
+        queue_append_owned((queue_owned_t**)queue, (queue_owned_t*)task);
     }
 
     task->estado = 's';
+
+    KERNEL_UNLOCK();
 }
 
 void task_resume(task_t *task) {
+    KERNEL_LOCK();
+
     /* Remove a task de sua fila atual e coloca-a na fila de tasks prontas. */
-    if (task->queue != NULL) {
-        queue_remove((queue_t**)(task->queue), (queue_t*)task);
+    task_unqueue(task);
+    if (task->sleepIndex >= 0) {
+        sleep_remove(task);
     }
+    ready_append(task);
 
-    queue_append((queue_t**)&readyQueue, (queue_t*)task);
-    task->queue = &readyQueue;
-    task->estado = 'r';
+    KERNEL_UNLOCK();
 }
 
 void task_yield() {
-    if (taskExec->estado != 's') {
+    core_t* c;
+    task_t* next;
+
+    KERNEL_LOCK();
+    c = this_core();
+
+    if (c->taskExec->estado != 's') {
         /* Recoloca a task no final da fila de prontas */
-        queue_append((queue_t**)&readyQueue, (queue_t*)taskExec);
-        taskExec->queue = &readyQueue;
-        taskExec->estado = 'r';
+        ready_append(c->taskExec);
+    }
+
+    /* Escolhe a prxima tarefa aqui mesmo e troca direto para ela, sem ir e voltar do dispatcher.
+     * O dispatcher s  ativado quando no h tarefa pronta no ncleo (para ficar ocioso ou
+     * roubar tarefas de outro ncleo) e para liberar as tarefas encerradas. */
+    dispatcher_wakeup();
+    next = scheduler(c, 0);
+
+    if (next == NULL) {
+        task_switch(&c->taskDisp);
+    }
+    else {
+        /* Reseta as ticks */
+        c->remainingTicks = RESET_TICKS;
+        c->needResched = 0;
+        next->estado = 'e';
+        if (next != c->taskExec) {
+            task_switch(next);
+        }
     }
 
-    /* Volta o controle para o dispatcher. */
-    task_switch(&taskDisp);
+    KERNEL_UNLOCK();
 }
 
 void task_setprio(task_t* task, int prio) {
+    KERNEL_LOCK();
+
     if (task == NULL) {
-        task = taskExec;
+        task = this_core()->taskExec;
     }
     if (prio <= MAX_PRIO && prio >= MIN_PRIO) {
+        /* A prioridade efetiva continua sendo a herdada, se esta for maior. */
+        task->basePrio = prio;
+        task_prio_update(task);
+    }
+
+    KERNEL_UNLOCK();
+}
+
+void task_prio_set(task_t* task, int prio) {
+    /* Se a tarefa estiver pronta, muda-a para a fila da nova prioridade. */
+    if (ready_contains(task)) {
+        ready_remove(task);
+        task->prio = prio;
+        task->dynPrio = prio;
+        ready_reinsert(task);
+    }
+    else {
         task->prio = prio;
         task->dynPrio = prio;
     }
 }
 
+void task_prio_update(task_t* task) {
+    mutex_t* m;
+    task_t* waiter;
+    int prio = task->basePrio;
+
+    for (m = task->heldMutexes; m != NULL; m = m->heldNext) {
+        if ((waiter = mutex_top_waiter(m)) != NULL && waiter->prio < prio) {
+            prio = waiter->prio;
+        }
+    }
+    if (prio != task->prio) {
+        task_prio_set(task, prio);
+    }
+}
+
+void task_prio_boost(task_t* task, int prio) {
+    int depth;
+
+    /* Segue a cadeia de donas (a dona pode estar esperando por outro mutex); o limite evita laos
+     * infinitos num impasse circular. */
+    for (depth = 0; task != NULL && prio < task->prio && depth < NUM_PRIO; depth++) {
+        task_prio_set(task, prio);
+        task = (task->blockedOn != NULL) ? task->blockedOn->owner : NULL;
+    }
+}
+
+void task_prio_unwind(task_t* task) {
+    int depth;
+    int prio;
+
+    /* A dona pode ter repassado a prioridade herdada s donas de quem ela espera: cada uma 
+     * recalculada, at uma cuja prioridade no mude. */
+    for (depth = 0; task != NULL && depth < NUM_PRIO; depth++) {
+        prio = task->prio;
+        task_prio_update(task);
+        if (task->prio == prio) {
+            break;
+        }
+        task = (task->blockedOn != NULL) ? task->blockedOn->owner : NULL;
+    }
+}
+
 int task_getprio(task_t* task) {
+    int prio;
+
+    KERNEL_LOCK();
     if (task == NULL) {
-        task = taskExec;
+        task = this_core()->taskExec;
     }
-    return task->prio;
+    prio = task->basePrio;
+    KERNEL_UNLOCK();
+
+    return prio;
 }
 
 int task_join(task_t* task) {
+    return task_join_wait(task, -1);
+}
+
+int task_join_try(task_t* task) {
+    return task_join_wait(task, 0);
+}
+
+int task_join_timed(task_t* task, int ms) {
+    return task_join_wait(task, (ms > 0) ? ms : 0);
+}
+
+int task_join_wait(task_t* task, int ms) {
     if (task == NULL) {
         return -1;
     }
+
+    KERNEL_LOCK();
+    /* Tarefas desvinculadas no podem ser esperadas: seu descritor pode j ter sido liberado. */
+    if (task->detached) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
     if (task->estado == 'x') {
+        KERNEL_UNLOCK();
         return task->exitCode;
     }
+    if (ms == 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
 
     /* Se a tarefa existir e no tiver terminado */
-    preempcao = 0; // Impede preempo
-    task_suspend(NULL, &(task->joinQueue));
-    preempcao = 1; // Retoma preempo
-    
-    task_yield();
+    if (task_block(&(task->joinQueue), ms) < 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    KERNEL_UNLOCK();
     return task->exitCode;
 }
 
-void task_sleep(int t) {
+int task_sleep(int t) {
+    if (t > 0) {
+        return task_sleep_ms(t*1000); // systime()  em milissegundos.
+    }
+    return 0;
+}
+
+int task_sleep_ms(int t) {
+    task_t* task;
+
     if(t > 0) {
-        taskExec->awakeTime = systime() + t*1000; // systime()  em milissegundos.
+        KERNEL_LOCK();
+        task = this_core()->taskExec;
+        task->awakeTime = systime() + t;
 
-        preempcao = 0; // Impede preempo
-        task_suspend(NULL, &sleepQueue);
-        preempcao = 1; // Retoma preempo
+        /* Sem memria para aumentar o heap, a tarefa no tem como ser acordada: no dorme. */
+        if (sleep_insert(task) < 0) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+        task_suspend(NULL, NULL);
         
         task_yield(); // Volta para o dispatcher.
+        KERNEL_UNLOCK();
     }
+    return 0;
 }
 
-void bodyDispatcher(void* arg) {
-    task_t* iterator;
-    task_t* awake;
-    unsigned int time;
+void task_stack_stats(long* hits, long* misses) {
+    KERNEL_LOCK();
+    if (hits != NULL) {
+        *hits = stackHits;
+    }
+    if (misses != NULL) {
+        *misses = stackMisses;
+    }
+    KERNEL_UNLOCK();
+}
 
-    while (countTasks > 0) {
-        if(readyQueue != NULL) {
-            task_t* next = scheduler();
-
-            if (next != NULL) {
-                /* Coloca a tarefa em execuo */
-                /* Reseta as ticks */
-                remainingTicks = RESET_TICKS;
-                queue_remove((queue_t**)&readyQueue, (queue_t*)next);
-                next->queue = NULL;
-                next->estado = 'e';
-                task_switch(next);
-
-                /* Libera a memoria da task, caso ela tenha dado exit. */
-                if (freeTask != NULL) {
-                    free(freeTask->context.uc_stack.ss_sp);
-                    freeTask = NULL;
-                }
-            }
-        }
+int stack_class(int size) {
+    int i;
 
-        /* Percorre a fila de tasks dormindo e acorda as tasks que devem ser acordadas. */
-        if (sleepQueue != NULL) {
-            iterator = sleepQueue;
-            time = systime();
-            do {
-                if(iterator->awakeTime <= time) {
-                    awake = iterator;
-                    iterator = iterator->next;
-                    task_resume(awake);
-                }
-                else {
-                    iterator = iterator->next;
-                }
-            } while (iterator != sleepQueue && sleepQueue != NULL);
+    for (i = 0; i < STACK_CLASSES; i++) {
+        if (size <= stackClassSize[i]) {
+            return i;
         }
     }
-    task_exit(0);
+
+    /* Maior que a maior classe: no passa pelo pool. */
+    return -1;
 }
 
-task_t* scheduler() {
-    task_t* iterator;
-    task_t* nextTask;
-    int minDynPrio;
-    int minPrio;
+void* stack_alloc(int* size) {
+    void* stack;
+    int i;
 
-    iterator = readyQueue;
-    nextTask = NULL;
-    minDynPrio = MAX_PRIO + 1;
-    minPrio = MAX_PRIO + 1;
+    i = stack_class(*size);
+    if (i < 0) {
+#ifdef STACK_MMAP
+        /* Fora das classes, o tamanho  arredondado para pginas inteiras, que so a unidade do mmap
+         * e da consulta do uso mximo em stack_highwater. */
+        *size = (*size + pageSize - 1) / pageSize * pageSize;
+#endif
+        stackMisses++;
+        return stack_new(*size);
+    }
 
-    /* Se a fila estiver vazia, retorna NULL. */
-    if (iterator == NULL) {
-        return NULL;
+    *size = stackClassSize[i];
+
+    /* Reaproveita uma pilha livre da classe, se houver. */
+    if (stackPool[i] != NULL) {
+        stack = stackPool[i];
+        stackPool[i] = STACK_LINK(stack, *size);
+        stackPoolCount[i]--;
+        stackHits++;
+        return stack;
     }
 
-    /* Busca a tarefa com menor dynPrio para executar. */
-    do {
-        if (iterator->dynPrio < minDynPrio) {
-            nextTask = iterator;
-            minDynPrio = iterator->dynPrio;
-            minPrio = iterator->prio;
-        }
-        else if (iterator->dynPrio == minDynPrio) { /* Desempate */
-            if (iterator->prio < minPrio) {
-                nextTask = iterator;
-                minDynPrio = iterator->dynPrio;
-                minPrio = iterator->prio;
-            }
-        }
+    stackMisses++;
+    return stack_new(*size);
+}
 
-        iterator = iterator->next;
-    } while (iterator != readyQueue);
+void stack_free(void* stack, int size) {
+    int i;
 
-    /* Retira a tarefa da fila e reseta sua prioridade dinamica. */
-    nextTask->dynPrio = nextTask->prio;
-    nextTask->dynPrio += ALPHA_PRIO; /* Para no precisar verificar se cada outra task  a nextTask ou no. */
+    if (stack == NULL) {
+        return;
+    }
 
-    /* Atualiza a dynprio das outras tarefas. */
-    iterator = readyQueue;
-    if (iterator != NULL) {
-        do {
-            iterator->dynPrio -= ALPHA_PRIO;
-            iterator = iterator->next;
-        } while (iterator != readyQueue);
+    i = stack_class(size);
+
+    /* Pilhas fora das classes, ou excedentes, so liberadas. */
+    if (i < 0 || stackClassSize[i] != size || stackPoolCount[i] >= STACK_POOL_MAX) {
+        stack_delete(stack, size);
+        return;
     }
 
-    return nextTask;
-}
+#ifdef STACK_MMAP
+    /* Devolve as pginas ao sistema; a faixa continua reservada e volta zerada quando for tocada. */
+    madvise(stack, size, MADV_DONTNEED);
+#endif
 
-void tickHandler() {
-    systemTime++;
+    STACK_LINK(stack, size) = stackPool[i];
+    stackPool[i] = stack;
+    stackPoolCount[i]++;
+}
 
-    if (taskExec != &taskDisp) {
-        remainingTicks--;
+#ifdef STACK_MMAP
+void* stack_new(int size) {
+    char* area;
 
-        if (preempcao && remainingTicks <= 0) {
-            task_yield();
-        }
+    /* Reserva a faixa sem comprometer memria (MAP_NORESERVE); as pginas s so alocadas quando a
+     * pilha cresce at elas. A pgina mais baixa fica sem acesso e detecta o estouro da pilha. */
+    area = mmap(NULL, size + pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (area == MAP_FAILED) {
+        return NULL;
+    }
+    if (mprotect(area, pageSize, PROT_NONE) < 0) {
+        munmap(area, size + pageSize);
+        return NULL;
     }
+
+    return area + pageSize;
 }
 
-unsigned int systime() {
-    return systemTime * TICK_MICROSECONDS / 1000;
+void stack_delete(void* stack, int size) {
+    munmap((char*)stack - pageSize, size + pageSize);
 }
 
-int sem_create(semaphore_t* s, int value) {
+int stack_highwater(task_t* task) {
+    unsigned char vec[64];
+    char* base;
+    int size;
+    int offset;
+    int pages;
+    int j;
+
+    base = task->context.uc_stack.ss_sp;
+    size = task->context.uc_stack.ss_size;
+    if (base == NULL) {
+        return -1;
+    }
+
+    /* A pilha cresce para baixo: a pgina residente de endereo mais baixo marca o uso mximo. */
+    for (offset = 0; offset < size; offset += pages * pageSize) {
+        pages = (size - offset) / pageSize;
+        if (pages > (int) sizeof(vec)) {
+            pages = sizeof(vec);
+        }
+        if (mincore(base + offset, pages * pageSize, vec) < 0) {
+            return -1;
+        }
+        for (j = 0; j < pages; j++) {
+            if (vec[j] & 1) {
+                return size - offset - j * pageSize;
+            }
+        }
+    }
+
+    return 0;
+}
+#else
+void* stack_new(int size) {
+    return malloc(size);
+}
+
+void stack_delete(void* stack, int size) {
+    free(stack);
+}
+
+int stack_highwater(task_t* task) {
+    /* Pilhas do malloc no permitem saber quanto foi usado. */
+    return -1;
+}
+#endif
+
+int task_stack_highwater(task_t* task) {
+    int highWater;
+
+    KERNEL_LOCK();
+    if (task == NULL) {
+        task = this_core()->taskExec;
+    }
+    if (task->estado == 'x') {
+        highWater = task->stackHighWater;
+    }
+    else {
+        highWater = stack_highwater(task);
+    }
+    KERNEL_UNLOCK();
+
+    return highWater;
+}
+
+int sleep_insert(task_t* task) {
+    task_t** heap;
+
+    /* Aumenta o heap se necessrio. */
+    if (sleepCount == sleepCapacity) {
+        heap = realloc(sleepHeap, (sleepCapacity > 0 ? 2 * sleepCapacity : SLEEP_HEAP_INITIAL) * sizeof(task_t*));
+        if (heap == NULL) {
+            perror("Erro na alocao do heap de tarefas dormindo: ");
+            return -1;
+        }
+        sleepHeap = heap;
+        sleepCapacity = (sleepCapacity > 0 ? 2 * sleepCapacity : SLEEP_HEAP_INITIAL);
+    }
+
+    sleepHeap[sleepCount] = task;
+    task->sleepIndex = sleepCount;
+    task->sleepSeq = sleepSeqNext++;
+    sleepCount++;
+    sleep_siftup(task->sleepIndex);
+
+    return 0;
+}
+
+void sleep_remove(task_t* task) {
+    int i = task->sleepIndex;
+
+    /* Coloca o ltimo elemento no lugar do removido e restaura a propriedade do heap. */
+    sleepCount--;
+    if (i != sleepCount) {
+        sleepHeap[i] = sleepHeap[sleepCount];
+        sleepHeap[i]->sleepIndex = i;
+        sleep_siftup(i);
+        sleep_siftdown(sleepHeap[i]->sleepIndex);
+    }
+    task->sleepIndex = -1;
+}
+
+int sleep_before(task_t* a, task_t* b) {
+    if (a->awakeTime != b->awakeTime) {
+        return a->awakeTime < b->awakeTime;
+    }
+    /* A diferena com sinal mantm a ordem mesmo quando o contador d a volta. */
+    return (int) (a->sleepSeq - b->sleepSeq) < 0;
+}
+
+void sleep_siftup(int i) {
+    task_t* task = sleepHeap[i];
+    int parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!sleep_before(task, sleepHeap[parent])) {
+            break;
+        }
+        sleepHeap[i] = sleepHeap[parent];
+        sleepHeap[i]->sleepIndex = i;
+        i = parent;
+    }
+    sleepHeap[i] = task;
+    task->sleepIndex = i;
+}
+
+void sleep_siftdown(int i) {
+    task_t* task = sleepHeap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < sleepCount) {
+        if (child + 1 < sleepCount && sleep_before(sleepHeap[child + 1], sleepHeap[child])) {
+            child++;
+        }
+        if (!sleep_before(sleepHeap[child], task)) {
+            break;
+        }
+        sleepHeap[i] = sleepHeap[child];
+        sleepHeap[i]->sleepIndex = i;
+        i = child;
+    }
+    sleepHeap[i] = task;
+    task->sleepIndex = i;
+}
+
+void bodyDispatcher(void* arg) {
+    dispatcher_loop();
+    task_exit(0);
+}
+
+void dispatcher_loop() {
+    core_t* c;
+    task_t* next;
+
+    /* O dispatcher nunca muda de ncleo. */
+    c = this_core();
+
+    KERNEL_LOCK();
+    while (countTasks > 0 || disk_flush_pending()) {
+        /* Uma tarefa escolhida em task_yield, sem passar pelo dispatcher, pode ter encerrado antes que
+         * ele executasse pela primeira vez: a troca no trmino dela entra aqui, e no depois de
+         * um task_switch do lao. */
+        dispatcher_release(c);
+
+        /* Sem tarefas de usurio, o sistema s continua at gravar os blocos sujos da cache do disco. */
+        if (countTasks == 0) {
+            disk_flush_wake();
+        }
+
+        next = scheduler(c, 0);
+#ifdef SMP
+        /* Sem tarefas prontas neste ncleo, tenta roubar uma de outro ncleo. */
+        if (next == NULL) {
+            next = steal_task(c);
+        }
+#endif
+
+        if (next != NULL) {
+            /* Coloca a tarefa em execuo */
+            /* Reseta as ticks */
+            c->remainingTicks = RESET_TICKS;
+            c->needResched = 0;
+            next->estado = 'e';
+            task_switch(next);
+
+            /* Libera a memoria da task, caso ela tenha dado exit. */
+            dispatcher_release(c);
+        }
+
+        dispatcher_wakeup();
+
+        /* Se no h nada para executar, dorme at o prximo evento em vez de girar no lao. */
+        if (c->readyBitmap == 0 && (countTasks > 0 || disk_flush_pending())) {
+            dispatcher_idle();
+        }
+    }
+    KERNEL_UNLOCK();
+}
+
+void dispatcher_release(core_t* c) {
+    if (c->freeTask != NULL) {
+        stack_free(c->freeTask->context.uc_stack.ss_sp, c->freeTask->context.uc_stack.ss_size);
+        if (c->freeTask->kernelOwned) {
+            free(c->freeTask);
+        }
+        c->freeTask = NULL;
+    }
+}
+
+void dispatcher_wakeup() {
+    unsigned int time;
+
+    /* Acorda as tasks cujo tempo de sono acabou; s a raiz do heap precisa ser consultada. */
+    time = systime();
+    while (sleepCount > 0 && sleepHeap[0]->awakeTime <= time) {
+        /* Se a tarefa estava numa espera com prazo, task_resume tambm a retira da fila da espera. */
+        sleepHeap[0]->timedOut = 1;
+        task_resume(sleepHeap[0]);
+    }
+
+    /* Acorda o gerenciador de disco se o disco terminou uma operao. */
+    if (disco.sinal && taskDiskMgr.estado == 's') {
+        task_resume(&taskDiskMgr);
+    }
+}
+
+#ifdef SMP
+void dispatcher_idle() {
+    core_t* c = this_core();
+    sigset_t mask, oldMask;
+    unsigned int startTime;
+    int i;
+
+    /* Outros ncleos podem ter trabalho para roubar ou acordar tarefas a qualquer momento, ento o
+     * ncleo ocioso libera a trava e dorme s at o prximo tick do seu temporizador. */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGALRM);
+    sigprocmask(SIG_BLOCK, &mask, &oldMask);
+    KERNEL_UNLOCK();
+
+    startTime = systime();
+    for (i = 0; i < numCores && cores[i].readyCount == 0; i++);
+    if (i == numCores) {
+        sigsuspend(&oldMask);
+    }
+
+    KERNEL_LOCK();
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+
+    /* O tempo ocioso no conta como tempo de processador do dispatcher. */
+    c->taskDisp.lastExecutionTime += systime() - startTime;
+}
+#else
+void dispatcher_idle() {
+    sigset_t mask, oldMask;
+    struct itimerval idleTimer;
+    struct timespec start, end;
+    unsigned int startTime;
+    unsigned int elapsed;
+    unsigned int wait;
+
+    /* Bloqueia os sinais antes de verificar se h trabalho, para que nenhum evento se perca
+     * entre a verificao e o sigsuspend (que os desbloqueia atomicamente). */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGALRM);
+    sigaddset(&mask, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &mask, &oldMask);
+
+    if (cores[0].readyBitmap != 0 || disco.sinal || (sleepCount > 0 && sleepHeap[0]->awakeTime <= systime())) {
+        sigprocmask(SIG_SETMASK, &oldMask, NULL);
+        return;
+    }
+
+    /* Reprograma o temporizador para o prximo despertar. Sem tarefas dormindo, s o disco pode
+     * gerar trabalho: se h uma operao em andamento, o temporizador  desligado e apenas o
+     * SIGUSR1 acorda o dispatcher; seno mantm o tick normal. */
+    idleTimer = timer;
+    if (sleepCount > 0) {
+        wait = sleepHeap[0]->awakeTime - systime();
+        idleTimer.it_value.tv_sec = wait / 1000;
+        idleTimer.it_value.tv_usec = (wait % 1000) * 1000;
+        setitimer(ITIMER_REAL, &idleTimer, 0);
+    }
+    else if (disco.numBlocks > 0 && !disco.livre) {
+        idleTimer.it_value.tv_sec = 0;
+        idleTimer.it_value.tv_usec = 0;
+        setitimer(ITIMER_REAL, &idleTimer, 0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    startTime = systemTime;
+
+    sigsuspend(&oldMask);
+
+    /* Os ticks no chegaram durante a espera; adianta o relgio do sistema pelo tempo real decorrido. */
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = ((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000) / TICK_MICROSECONDS;
+    if (systemTime - startTime < elapsed) {
+        systemTime = startTime + elapsed;
+    }
+
+    /* O tempo ocioso no conta como tempo de processador do dispatcher. */
+    cores[0].taskDisp.lastExecutionTime += (systemTime - startTime) * TICK_MICROSECONDS / 1000;
+
+    /* Volta ao tick peridico. */
+    setitimer(ITIMER_REAL, &timer, 0);
+
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+}
+#endif
+
+task_t* scheduler(core_t* c, int migrating) {
+    unsigned long long bitmap;
+    task_t* nextTask;
+    task_t* task;
+    int minDynPrio;
+    int dynPrio;
+    int i;
+
+    nextTask = NULL;
+    minDynPrio = 0;
+
+    /* Se todas as filas estiverem vazias, retorna NULL. */
+    if (c->readyBitmap == 0) {
+        return NULL;
+    }
+
+    /* Todas as tarefas prontas envelhecem ALPHA_PRIO a cada escalonamento, ento a prioridade
+     * dinmica de uma tarefa  a sua prioridade esttica menos o envelhecimento acumulado desde
+     * que ela entrou na fila de prontas (readyEpoch - task->readyEpoch). Dentro de uma mesma fila
+     * a cabea  a tarefa mais antiga, logo a de menor dynPrio; basta comparar as cabeas das
+     * filas no vazias, o que custa no mximo NUM_PRIO iteraes, independente do nmero de
+     * tarefas prontas. As filas so percorridas em ordem crescente de prioridade esttica, ento
+     * o desempate (comparao estrita) favorece a de menor prio. */
+    bitmap = c->readyBitmap;
+    while (bitmap != 0) {
+        i = __builtin_ctzll(bitmap);
+        bitmap &= bitmap - 1;
+
+        task = c->readyQueue[i];
+        if (migrating) {
+            /* S tarefas sem afinidade podem ir para outro ncleo: usa a mais antiga delas. */
+            while (task->affinity >= 0 && task->next != c->readyQueue[i]) {
+                task = task->next;
+            }
+            if (task->affinity >= 0) {
+                continue;
+            }
+        }
+
+        dynPrio = (i + MIN_PRIO) - ALPHA_PRIO * (int)(c->readyEpoch - task->readyEpoch);
+        if (nextTask == NULL || dynPrio < minDynPrio) {
+            nextTask = task;
+            minDynPrio = dynPrio;
+        }
+    }
+
+    if (nextTask == NULL) {
+        return NULL;
+    }
+
+    /* Envelhece todas as outras tarefas prontas de uma s vez. */
+    c->readyEpoch++;
+
+    /* Retira a tarefa da fila e reseta sua prioridade dinamica. */
+    ready_remove(nextTask);
+    nextTask->dynPrio = nextTask->prio;
+
+    return nextTask;
+}
+
+void ready_append(task_t* task) {
+    core_t* c = (task->affinity >= 0) ? &cores[task->affinity] : this_core();
+    int i = task->prio - MIN_PRIO;
+
+    /* Uma tarefa que j est pronta (a main, por exemplo, no primeiro task_yield) no  inserida de novo. */
+    if (ready_contains(task)) {
+        return;
+    }
+
+    queue_append_owned((queue_owned_t**)&c->readyQueue[i], (queue_owned_t*)task);
+    task->core = c;
+    task->estado = 'r';
+    task->readyEpoch = c->readyEpoch;
+    c->readyBitmap |= 1ULL << i;
+    if (task->affinity < 0) {
+        c->readyCount++;
+    }
+}
+
+void ready_reinsert(task_t* task) {
+    core_t* c = task->core;
+    int i = task->prio - MIN_PRIO;
+    task_t* next = c->readyQueue[i];
+    task_t* before = NULL;
+
+    /* A fila de cada prioridade est em ordem de readyEpoch (a cabea  a mais antiga). */
+    if (next != NULL) {
+        do {
+            if ((int)(next->readyEpoch - task->readyEpoch) > 0) {
+                before = next;
+                break;
+            }
+            next = next->next;
+        } while (next != c->readyQueue[i]);
+    }
+
+    queue_insert_owned((queue_owned_t**)&c->readyQueue[i], (queue_owned_t*)task, (queue_owned_t*)before);
+    c->readyBitmap |= 1ULL << i;
+    if (task->affinity < 0) {
+        c->readyCount++;
+    }
+}
+
+void ready_remove(task_t* task) {
+    core_t* c = task->core;
+    int i = task->queue - c->readyQueue;
+
+    queue_remove_owned((queue_owned_t*)task);
+    if (c->readyQueue[i] == NULL) {
+        c->readyBitmap &= ~(1ULL << i);
+    }
+    if (task->affinity < 0) {
+        c->readyCount--;
+    }
+}
+
+int ready_contains(task_t* task) {
+    return (task->core != NULL && task->queue >= task->core->readyQueue && task->queue < task->core->readyQueue + NUM_PRIO);
+}
+
+void task_unqueue(task_t* task) {
+    if (task->queue == NULL) {
+        return;
+    }
+
+    if (ready_contains(task)) {
+        ready_remove(task);
+    }
+    else {
+        queue_remove_owned((queue_owned_t*)task);
+    }
+}
+
+int task_block(task_t** queue, int ms) {
+    task_t* task = this_core()->taskExec;
+
+    task->timedOut = 0;
+    task_suspend(task, queue);
+    if (ms >= 0) {
+        task->awakeTime = systime() + ms;
+        /* Sem memria para o heap, a espera simplesmente fica sem prazo. */
+        sleep_insert(task);
+    }
+
+    task_yield();
+
+    return task->timedOut ? -1 : 0;
+}
+
+void kernel_lock() {
+    task_t* self;
+#ifdef SMP
+    core_t* c;
+
+    /* L a tarefa corrente de forma estvel: se ela for preemptada e migrar de ncleo entre as
+     * duas leituras, tenta de novo. */
+    do {
+        c = this_core();
+        self = c->taskExec;
+    } while (c != this_core());
+
+    /* Incrementa antes de adquirir: com preemptCount > 0 o tratador de ticks no preempta a tarefa. */
+    if (self->preemptCount++ == 0) {
+        while (__atomic_exchange_n(&kernelLock, 1, __ATOMIC_ACQUIRE)) {
+            while (__atomic_load_n(&kernelLock, __ATOMIC_RELAXED)) {
+                cpu_relax();
+            }
+        }
+    }
+#else
+    self = this_core()->taskExec;
+    self->preemptCount++;
+#endif
+    /* O tratador de ticks deve ver o contador antes de qualquer acesso da seo crtica. */
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+void kernel_unlock() {
+    task_t* self = this_core()->taskExec;
+
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+#ifdef SMP
+    /* Libera antes de decrementar, pelo mesmo motivo. */
+    if (self->preemptCount == 1) {
+        __atomic_store_n(&kernelLock, 0, __ATOMIC_RELEASE);
+    }
+#endif
+    self->preemptCount--;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+    /* Faz a troca adiada por um tick que chegou dentro da seo crtica. Um tick posterior ao
+     * decremento j preempta a tarefa diretamente, e a troca limpa needResched. */
+    if (self->preemptCount == 0 && this_core()->needResched && self != &this_core()->taskDisp) {
+        task_yield();
+    }
+}
+
+#ifdef SMP
+core_t* this_core() {
+    /* Nunca expandida em linha: aps uma troca de contexto a tarefa pode estar em outra thread, e o
+     * compilador no pode reaproveitar um endereo de varivel de thread calculado antes dela. */
+    return currentCore;
+}
+
+void* core_main(void* arg) {
+    core_t* c = (core_t*) arg;
+
+    currentCore = c;
+
+    /* O dispatcher do ncleo executa na prpria pilha da thread. */
+    c->taskDisp.main = &taskMain;
+    c->taskDisp.tid = -c->id;
+    c->taskDisp.estado = 'e';
+    c->taskDisp.core = c;
+    c->taskDisp.sleepIndex = -1;
+    c->taskDisp.creationTime = systime();
+    c->taskDisp.lastExecutionTime = systime();
+    c->taskExec = &c->taskDisp;
+
+    core_timer_start(c);
+
+    dispatcher_loop();
+
+    timer_delete(c->tickTimer);
+    return NULL;
+}
+
+void core_timer_start(core_t* c) {
+    struct sigevent event;
+    struct itimerspec tick;
+
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGALRM;
+    event.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_MONOTONIC, &event, &c->tickTimer) < 0) {
+        perror("Erro em timer_create: ");
+        exit(1);
+    }
+
+    tick.it_value.tv_sec = 0;
+    tick.it_value.tv_nsec = TICK_MICROSECONDS * 1000;
+    tick.it_interval = tick.it_value;
+    if (timer_settime(c->tickTimer, 0, &tick, NULL) < 0) {
+        perror("Erro em timer_settime: ");
+        exit(1);
+    }
+}
+
+task_t* steal_task(core_t* c) {
+    core_t* victim;
+    int i;
+
+    victim = NULL;
+    for (i = 0; i < numCores; i++) {
+        if (&cores[i] != c && cores[i].readyCount > 0 && (victim == NULL || cores[i].readyCount > victim->readyCount)) {
+            victim = &cores[i];
+        }
+    }
+
+    if (victim == NULL) {
+        return NULL;
+    }
+
+    return scheduler(victim, 1);
+}
+
+/* Limites do cdigo do executvel, definidos pelo ligador. */
+extern char __executable_start[];
+extern char etext[];
+
+int preempt_safe(void* context) {
+    ucontext_t* uc = (ucontext_t*) context;
+    unsigned long pc;
+
+    /* Uma tarefa interrompida dentro da libc pode estar segurando uma trava interna (stdio,
+     * malloc); se ela migrasse de thread, as outras threads poderiam bloquear nessa trava sem que
+     * ningum a libere. S preempta quando o contador de programa est no prprio executvel;
+     * caso contrrio a preempo fica para o prximo tick. */
+#if defined(__x86_64__)
+    pc = uc->uc_mcontext.gregs[16]; // REG_RIP, s declarado com _GNU_SOURCE
+#elif defined(__aarch64__)
+    pc = uc->uc_mcontext.pc;
+#else
+    return 1;
+#endif
+    return (pc >= (unsigned long) __executable_start && pc < (unsigned long) etext);
+}
+
+void tickHandler(int signum, siginfo_t* info, void* context) {
+    core_t* c = this_core();
+
+    /* Apenas o ncleo 0 conta o relgio do sistema. */
+    if (c->id == 0) {
+        systemTime++;
+    }
+
+    if (c->taskExec != &c->taskDisp) {
+        c->remainingTicks--;
+
+        if (c->remainingTicks <= 0) {
+            /* Dentro de uma seo crtica a troca fica para a sua sada (kernel_unlock). */
+            if (c->taskExec->preemptCount > 0) {
+                c->needResched = 1;
+            }
+            else if (preempt_safe(context)) {
+                task_preempt();
+            }
+        }
+    }
+}
+#else
+void tickHandler(int signum, siginfo_t* info, void* context) {
+    core_t* c = this_core();
+
+    systemTime++;
+
+    if (c->taskExec != &c->taskDisp) {
+        c->remainingTicks--;
+
+        if (c->remainingTicks <= 0) {
+            /* Dentro de uma seo crtica a troca fica para a sua sada (kernel_unlock). */
+            if (c->taskExec->preemptCount > 0) {
+                c->needResched = 1;
+            }
+            else {
+                task_preempt();
+            }
+        }
+    }
+}
+#endif
+
+void task_preempt() {
+#ifdef CTX_ASM
+    /* O SIGALRM fica bloqueado enquanto o tratador executa. */
+    this_core()->taskExec->preempted = 1;
+    this_core()->alarmMasked = 1;
+#endif
+
+    task_yield();
+
+#ifdef CTX_ASM
+    /* De volta ao tratador, talvez em outro ncleo; o retorno do tratador libera o SIGALRM. */
+    this_core()->taskExec->preempted = 0;
+    this_core()->alarmMasked = 0;
+#endif
+}
+
+unsigned int systime() {
+    return systemTime * TICK_MICROSECONDS / 1000;
+}
+
+int sem_create(semaphore_t* s, int value) {
+    KERNEL_LOCK();
     if (s == NULL) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    s->queue = NULL;
+    s->value = value;
+    s->active = 1;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int sem_down(semaphore_t* s) {
+    return sem_down_wait(s, -1);
+}
+
+int sem_down_try(semaphore_t* s) {
+    return sem_down_wait(s, 0);
+}
+
+int sem_down_timed(semaphore_t* s, int ms) {
+    return sem_down_wait(s, (ms > 0) ? ms : 0);
+}
+
+int sem_down_wait(semaphore_t* s, int ms) {
+    KERNEL_LOCK();
+    if (s == NULL || !(s->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    if (s->value <= 0 && ms == 0) {
+        // Sem vagas e sem poder esperar.
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    s->value--;
+    if (s->value < 0) {
+        // Caso no existam mais vagas no semforo, suspende a tarefa.
+        if (task_block(&(s->queue), ms) < 0) {
+            // O prazo venceu: a tarefa desiste da vaga que tinha reservado.
+            if (s->active) {
+                s->value++;
+            }
+            KERNEL_UNLOCK();
+            return -1;
+        }
+
+        // Se a tarefa foi acordada devido a um sem_destroy, retorna -1.
+        if (!(s->active)) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+        
+        KERNEL_UNLOCK();
+        return 0;
+    }
+    
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int sem_up(semaphore_t* s) {
+    KERNEL_LOCK();
+    if (s == NULL || !(s->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    s->value++;
+    // A fila pode estar vazia se a tarefa que esperava desistiu por prazo e ainda no devolveu a vaga.
+    if (s->value <= 0 && s->queue != NULL) {
+        task_resume(s->queue);
+    }
+    
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int sem_down_upto(semaphore_t* s, int n) {
+    int taken;
+
+    KERNEL_LOCK();
+    if (s == NULL || !(s->active) || n <= 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    if (s->value <= 0) {
+        // Sem unidades disponveis, espera por uma como em sem_down.
+        s->value--;
+        task_block(&(s->queue), -1);
+
+        if (!(s->active)) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+
+        KERNEL_UNLOCK();
+        return 1;
+    }
+
+    taken = (s->value < n) ? s->value : n;
+    s->value -= taken;
+
+    KERNEL_UNLOCK();
+    return taken;
+}
+
+int sem_up_n(semaphore_t* s, int n) {
+    int waiting;
+
+    KERNEL_LOCK();
+    if (s == NULL || !(s->active) || n < 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    // Acorda uma tarefa para cada unidade que cobre uma espera (valor negativo).
+    waiting = (s->value < 0) ? -(s->value) : 0;
+    s->value += n;
+    for (waiting = (waiting < n) ? waiting : n; waiting > 0 && s->queue != NULL; waiting--) {
+        task_resume(s->queue);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int sem_destroy(semaphore_t* s) {
+    KERNEL_LOCK();
+    if (s == NULL || !(s->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    s->active = 0;
+    while (s->queue != NULL) {
+        task_resume(s->queue);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int mutex_create(mutex_t* m) {
+    return mutex_create_type(m, MUTEX_NORMAL);
+}
+
+int mutex_create_type(mutex_t* m, int type) {
+    KERNEL_LOCK();
+    if (m == NULL || type < MUTEX_NORMAL || type > MUTEX_ERRORCHECK) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    m->queue = NULL;
+    m->value = 1;
+    m->owner = NULL;
+    m->heldNext = NULL;
+    m->count = 0;
+    m->type = type;
+    m->active = 1;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int mutex_lock(mutex_t* m) {
+    return mutex_lock_wait(m, -1);
+}
+
+int mutex_lock_try(mutex_t* m) {
+    return mutex_lock_wait(m, 0);
+}
+
+int mutex_lock_timed(mutex_t* m, int ms) {
+    return mutex_lock_wait(m, (ms > 0) ? ms : 0);
+}
+
+int mutex_lock_wait(mutex_t* m, int ms) {
+    task_t* self;
+#ifdef SMP
+    task_t* owner;
+    core_t* ownerCore;
+    int spins;
+    int i;
+#endif
+
+    KERNEL_LOCK();
+    if (m == NULL || !(m->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    self = this_core()->taskExec;
+    if (m->value == 0 && m->owner == self) {
+        if (m->type == MUTEX_RECURSIVE) {
+            m->count++;
+            KERNEL_UNLOCK();
+            return 0;
+        }
+        if (m->type == MUTEX_ERRORCHECK) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+    }
+
+#ifdef SMP
+    /* Se a dona est executando em outro ncleo, ela deve liberar o mutex logo: espera ativamente
+     * (com a trava do ncleo liberada) por algumas voltas antes de pagar duas trocas de contexto.
+     * S  possvel fora de outras sees da trava do ncleo. Sem a trava, a dona pode terminar e
+     * ser liberada: a espera s compara ponteiros (o mutex continua com ela e o ncleo em que ela
+     * executava ainda a executa), sem acessar o descritor da dona. */
+    if (m->value == 0 && ms != 0 && self->preemptCount == 1) {
+        owner = m->owner;
+        ownerCore = NULL;
+        for (i = 0; i < numCores; i++) {
+            if (cores[i].taskExec == owner) {
+                ownerCore = &cores[i];
+            }
+        }
+        if (ownerCore != NULL) {
+            KERNEL_UNLOCK();
+            for (spins = 0; spins < MUTEX_SPIN_LIMIT; spins++) {
+                if (__atomic_load_n(&(m->value), __ATOMIC_RELAXED) != 0
+                    || __atomic_load_n(&(m->owner), __ATOMIC_RELAXED) != owner
+                    || __atomic_load_n(&(ownerCore->taskExec), __ATOMIC_RELAXED) != owner) {
+                    break;
+                }
+                cpu_relax();
+            }
+            KERNEL_LOCK();
+            if (!(m->active)) {
+                KERNEL_UNLOCK();
+                return -1;
+            }
+        }
+    }
+#endif
+
+    if (m->value == 0) { // Se j estiver travado, suspende a task
+        if (ms == 0) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+
+        // Empresta a prioridade  dona enquanto espera.
+        self->blockedOn = m;
+        task_prio_boost(m->owner, self->prio);
+
+        // Se o prazo venceu, a tarefa j saiu da fila e o mutex no lhe foi passado.
+        if (task_block(&(m->queue), ms) < 0) {
+            self->blockedOn = NULL;
+            // Sem esta tarefa na fila, a dona pode perder a prioridade herdada dela.
+            if (m->active && m->owner != NULL) {
+                task_prio_unwind(m->owner);
+            }
+            KERNEL_UNLOCK();
+            return -1;
+        }
+
+        // Se a tarefa foi acordada devido a um mutex_destroy, retorna -1.
+        if (!(m->active)) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+
+        // mutex_unlock j passou o mutex (e a posse) para esta tarefa.
+        KERNEL_UNLOCK();
+        return 0;
+    }
+
+    mutex_give(m, self); // Se no estiver travado, trava e obtm o mutex.
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int mutex_unlock(mutex_t* m) {
+    task_t* next;
+
+    KERNEL_LOCK();
+    if (m == NULL || !(m->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    if (m->type != MUTEX_NORMAL && (m->value != 0 || m->owner != this_core()->taskExec)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    if (m->type == MUTEX_RECURSIVE && --(m->count) > 0) {
+        KERNEL_UNLOCK();
+        return 0;
+    }
+
+    next = mutex_release(m);
+
+    // Passa o processador logo se o mutex foi para uma tarefa mais prioritria.
+    if (next != NULL && next->prio < this_core()->taskExec->prio) {
+        task_yield();
+    }
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int mutex_destroy(mutex_t* m) {
+    task_t* owner;
+
+    KERNEL_LOCK();
+    if (m == NULL || !(m->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    m->active = 0;
+    owner = m->owner;
+    mutex_held_remove(m);
+    m->owner = NULL;
+    while (m->queue != NULL) {
+        m->queue->blockedOn = NULL;
+        task_resume(m->queue);
+    }
+    if (owner != NULL) {
+        task_prio_unwind(owner);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+void mutex_give(mutex_t* m, task_t* task) {
+    m->value = 0;
+    m->owner = task;
+    m->count = 1;
+    m->heldNext = task->heldMutexes;
+    task->heldMutexes = m;
+    task->blockedOn = NULL;
+}
+
+task_t* mutex_release(mutex_t* m) {
+    task_t* owner = m->owner;
+    task_t* next = NULL;
+
+    mutex_held_remove(m);
+
+    if (m->queue != NULL) { // Se alguma task estiver esperando na fila, mantm o mutex travado e o passa para a de maior prioridade.
+        next = mutex_top_waiter(m);
+        mutex_give(m, next);
+        // A nova dona herda a prioridade de quem continua esperando, antes de entrar na fila de prontas.
+        task_prio_update(next);
+        task_resume(next);
+    }
+    else { // Se no tiver nenhuma task esperando, libera o mutex.
+        m->owner = NULL;
+        m->count = 0;
+        m->value = 1;
+    }
+
+    // A antiga dona perde a prioridade herdada por causa deste mutex.
+    if (owner != NULL) {
+        task_prio_update(owner);
+    }
+
+    return next;
+}
+
+task_t* mutex_top_waiter(mutex_t* m) {
+    task_t* top = m->queue;
+    task_t* task;
+
+    if (top == NULL) {
+        return NULL;
+    }
+    for (task = top->next; task != m->queue; task = task->next) {
+        if (task->prio < top->prio) {
+            top = task;
+        }
+    }
+    return top;
+}
+
+void mutex_held_remove(mutex_t* m) {
+    mutex_t** link;
+
+    if (m->owner == NULL) {
+        return;
+    }
+    for (link = &(m->owner->heldMutexes); *link != NULL; link = &((*link)->heldNext)) {
+        if (*link == m) {
+            *link = m->heldNext;
+            break;
+        }
+    }
+    m->heldNext = NULL;
+}
+
+int cond_create(cond_t* c) {
+    KERNEL_LOCK();
+    if (c == NULL) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    c->queue = NULL;
+    c->mutex = NULL;
+    c->active = 1;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int cond_wait(cond_t* c, mutex_t* m) {
+    task_t* self;
+    int count;
+
+    KERNEL_LOCK();
+    self = this_core()->taskExec;
+    if (c == NULL || !(c->active) || m == NULL || !(m->active) || m->value != 0 || m->owner != self) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    // Todas as tarefas esperando na condio devem usar o mesmo mutex.
+    if (c->queue != NULL && c->mutex != m) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    c->mutex = m;
+
+    /* Entra na fila da condio antes de liberar o mutex, para que um cond_signal feito por quem
+     * obtiver o mutex j encontre esta tarefa. Um mutex recursivo  liberado por completo. */
+    count = m->count;
+    task_suspend(self, &(c->queue));
+    mutex_release(m);
+    task_block(NULL, -1);
+
+    // Quem acordou a tarefa j lhe entregou o mutex; sem isso, foi um cond_destroy ou mutex_destroy.
+    if (!(c->active) || !(m->active) || m->owner != self) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    m->count = count;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+void cond_wake(cond_t* c, task_t* task) {
+    mutex_t* m = c->mutex;
+
+    if (m->value == 0) {
+        // Mutex ocupado: a tarefa passa a esperar por ele, herdando a prioridade como em mutex_lock.
+        task_suspend(task, &(m->queue));
+        task->blockedOn = m;
+        task_prio_boost(m->owner, task->prio);
+    }
+    else {
+        mutex_give(m, task);
+        task_prio_update(task);
+        task_resume(task);
+    }
+}
+
+int cond_signal(cond_t* c) {
+    KERNEL_LOCK();
+    if (c == NULL || !(c->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    if (c->queue != NULL) {
+        cond_wake(c, c->queue);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int cond_broadcast(cond_t* c) {
+    KERNEL_LOCK();
+    if (c == NULL || !(c->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    // No mximo uma tarefa recebe o mutex e acorda; as outras passam para a fila do mutex.
+    while (c->queue != NULL) {
+        cond_wake(c, c->queue);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int cond_destroy(cond_t* c) {
+    KERNEL_LOCK();
+    if (c == NULL || !(c->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    c->active = 0;
+    while (c->queue != NULL) {
+        task_resume(c->queue);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int rwlock_create(rwlock_t* rw) {
+    KERNEL_LOCK();
+    if (rw == NULL) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    rw->readQueue = NULL;
+    rw->writeQueue = NULL;
+    rw->readers = 0;
+    rw->holders = NULL;
+    rw->writer = NULL;
+    rw->active = 1;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+readhold_t* rwlock_read_hold(task_t* task, rwlock_t* rw, int create) {
+    readhold_t* hold;
+
+    for (hold = rw->holders; hold != NULL; hold = hold->next) {
+        if (hold->task == task) {
+            return hold;
+        }
+    }
+    if (!create || (hold = malloc(sizeof(readhold_t))) == NULL) {
+        return NULL;
+    }
+
+    hold->task = task;
+    hold->count = 0;
+    hold->next = rw->holders;
+    rw->holders = hold;
+    return hold;
+}
+
+void rwlock_read_release(rwlock_t* rw, readhold_t* hold) {
+    readhold_t** link;
+
+    for (link = &(rw->holders); *link != hold; link = &((*link)->next));
+    *link = hold->next;
+    free(hold);
+}
+
+int rwlock_rdlock(rwlock_t* rw) {
+    readhold_t* hold;
+
+    KERNEL_LOCK();
+    if (rw == NULL || !(rw->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    // O registro do leitor  criado antes de esperar; sem memria para ele, a leitura  recusada.
+    hold = rwlock_read_hold(this_core()->taskExec, rw, 1);
+    if (hold == NULL) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    // Quem j l a trava a obtm de novo na hora: se esperasse pelo escritor da fila, que espera as
+    // leituras acabarem, a tarefa esperaria por si mesma.
+    if (hold->count > 0) {
+        rw->readers++;
+    }
+    // Preferncia aos escritores: um novo leitor tambm espera se houver escritor na fila.
+    else if (rw->writer != NULL || rw->writeQueue != NULL) {
+        task_block(&(rw->readQueue), -1);
+
+        // Quem acordou o leitor j o contou em readers; sem isso, foi um rwlock_destroy.
+        if (!(rw->active)) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+    }
+    else {
+        rw->readers++;
+    }
+
+    hold->count++;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int rwlock_wrlock(rwlock_t* rw) {
+    task_t* self;
+
+    KERNEL_LOCK();
+    if (rw == NULL || !(rw->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    self = this_core()->taskExec;
+
+    if (rw->writer != NULL || rw->readers > 0) {
+        task_block(&(rw->writeQueue), -1);
+
+        // Quem acordou o escritor j lhe passou a trava; sem isso, foi um rwlock_destroy.
+        if (!(rw->active)) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+
+        KERNEL_UNLOCK();
+        return 0;
+    }
+
+    rw->writer = self;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int rwlock_unlock(rwlock_t* rw) {
+    readhold_t* hold;
+
+    KERNEL_LOCK();
+    if (rw == NULL || !(rw->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    if (rw->writer != NULL) {
+        if (rw->writer != this_core()->taskExec) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+        rw->writer = NULL;
+    }
+    else {
+        // S libera uma leitura quem a obteve com rwlock_rdlock.
+        hold = rwlock_read_hold(this_core()->taskExec, rw, 0);
+        if (hold == NULL || hold->count == 0) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
+        if (--(hold->count) == 0) {
+            rwlock_read_release(rw, hold);
+        }
+        rw->readers--;
+    }
+
+    if (rw->readers == 0) {
+        if (rw->writeQueue != NULL) {
+            // Passa a trava para o prximo escritor.
+            rw->writer = rw->writeQueue;
+            task_resume(rw->writeQueue);
+        }
+        else {
+            // Sem escritores esperando, acorda todos os leitores de uma vez.
+            while (rw->readQueue != NULL) {
+                rw->readers++;
+                task_resume(rw->readQueue);
+            }
+        }
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int rwlock_destroy(rwlock_t* rw) {
+    KERNEL_LOCK();
+    if (rw == NULL || !(rw->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    rw->active = 0;
+    while (rw->readQueue != NULL) {
+        task_resume(rw->readQueue);
+    }
+    while (rw->writeQueue != NULL) {
+        task_resume(rw->writeQueue);
+    }
+    while (rw->holders != NULL) {
+        rwlock_read_release(rw, rw->holders);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int barrier_create(barrier_t* b, int N) {
+    KERNEL_LOCK();
+    if (b == NULL || N <= 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    b->queue = NULL;
+    b->maxTasks = N;
+    b->countTasks = 0;
+    b->generation = 0;
+    b->active = 1;
+    
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int barrier_join(barrier_t* b) {
+    return barrier_join_wait(b, -1);
+}
+
+int barrier_join_try(barrier_t* b) {
+    return barrier_join_wait(b, 0);
+}
+
+int barrier_join_timed(barrier_t* b, int ms) {
+    return barrier_join_wait(b, (ms > 0) ? ms : 0);
+}
+
+int barrier_join_wait(barrier_t* b, int ms) {
+    unsigned int generation;
+
+    KERNEL_LOCK();
+    if (b == NULL || !(b->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    if (ms == 0 && b->countTasks + 1 < b->maxTasks) {
+        // S entra se for a ltima tarefa, que libera a barreira sem esperar.
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    b->countTasks++;
+
+    if (b->countTasks == b->maxTasks) {
+        while (b->queue != NULL) {
+            task_resume(b->queue);
+        }
+        b->countTasks = 0;
+        b->generation++;
+        KERNEL_UNLOCK();
+        return 0;
+    }
+
+    generation = b->generation;
+    if (task_block(&(b->queue), ms) < 0) {
+        // Se a barreira foi liberada depois do prazo mas antes de a tarefa voltar, ela foi contada.
+        if (b->active && b->generation == generation) {
+            b->countTasks--;
+            KERNEL_UNLOCK();
+            return -1;
+        }
+    }
+    
+    if(!(b->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int barrier_destroy(barrier_t* b) {
+    KERNEL_LOCK();
+    if (b == NULL || !(b->active)) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    b->active = 0;
+    while (b->queue != NULL) {
+        task_resume(b->queue);
+    }
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int mqueue_create(mqueue_t* queue, int max, int size) {
+    int i;
+
+    KERNEL_LOCK();
+    if(queue == NULL || max <= 0 || size <= 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    
+    queue->content = malloc(max * size);
+    queue->ring = malloc(max * sizeof(void*));
+    queue->freeSlots = malloc(max * sizeof(void*));
+    queue->slotState = malloc(max);
+    if (queue->content == NULL || queue->ring == NULL || queue->freeSlots == NULL || queue->slotState == NULL) {
+        perror("Erro ao alocar a fila de mensagens: ");
+        free(queue->content);
+        free(queue->ring);
+        free(queue->freeSlots);
+        free(queue->slotState);
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    queue->messageSize = size;
+    queue->maxMessages = max;
+    queue->countMessages = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->spsc = 0;
+    queue->spscWait[0] = queue->spscWait[1] = NULL;
+    queue->spscWaiting[0] = queue->spscWaiting[1] = 0;
+
+    /* Todos os slots comeam livres. */
+    for (i = 0; i < max; i++) {
+        queue->freeSlots[i] = queue->content + (max - 1 - i) * size;
+        queue->slotState[i] = MQUEUE_SLOT_FREE;
+    }
+    queue->freeCount = max;
+    
+    sem_create(&(queue->sBuffer), 1);
+    sem_create(&(queue->sItem), 0);
+    sem_create(&(queue->sVaga), max);
+    
+    queue->active = 1;
+    
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int mqueue_create_spsc(mqueue_t* queue, int max, int size) {
+    KERNEL_LOCK();
+    if(queue == NULL || max <= 0 || size <= 0) {
+        KERNEL_UNLOCK();
+        return -1;
+    }
+
+    queue->content = malloc(max * size);
+    if (queue->content == NULL) {
+        perror("Erro ao alocar a fila de mensagens: ");
+        KERNEL_UNLOCK();
+        return -1;
+    }
+    queue->ring = NULL;
+    queue->freeSlots = NULL;
+    queue->slotState = NULL;
+    queue->freeCount = 0;
+    queue->messageSize = size;
+    queue->maxMessages = max;
+    queue->countMessages = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->spsc = 1;
+    queue->spscWait[0] = queue->spscWait[1] = NULL;
+    queue->spscWaiting[0] = queue->spscWaiting[1] = 0;
+
+    queue->active = 1;
+
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+/* head e tail contam mdulo 2*maxMessages, para distinguir a fila cheia da vazia sem contador compartilhado. */
+int mqueue_spsc_count(mqueue_t* queue) {
+    int head = __atomic_load_n(&(queue->head), __ATOMIC_ACQUIRE);
+    int tail = __atomic_load_n(&(queue->tail), __ATOMIC_ACQUIRE);
+
+    return (tail - head + 2 * queue->maxMessages) % (2 * queue->maxMessages);
+}
+
+/* Bloqueia o lado indicado at que o outro o acorde, ou por at ms milissegundos (ms >= 0). O indicador
+ * spscWaiting  publicado antes de conferir a fila de novo, e o outro lado publica o ndice antes de
+ * ler o indicador: um dos dois sempre v a escrita do outro, e nenhum despertar  perdido.
+ * Retorna -1 se o prazo venceu. */
+int mqueue_spsc_wait(mqueue_t* queue, int side, int ms) {
+    int count, ret = 0;
+
+    KERNEL_LOCK();
+
+    __atomic_store_n(&(queue->spscWaiting[side]), 1, __ATOMIC_SEQ_CST);
+    count = mqueue_spsc_count(queue);
+    if (queue->active && (side == 0 ? count == queue->maxMessages : count == 0)) {
+        ret = task_block(&(queue->spscWait[side]), ms);
+    }
+    __atomic_store_n(&(queue->spscWaiting[side]), 0, __ATOMIC_RELAXED);
+
+    KERNEL_UNLOCK();
+    return ret;
+}
+
+void mqueue_spsc_wake(mqueue_t* queue, int side) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&(queue->spscWaiting[side]), __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    KERNEL_LOCK();
+    if (queue->spscWait[side] != NULL) {
+        task_resume(queue->spscWait[side]);
+    }
+    KERNEL_UNLOCK();
+}
+
+/* Envia com prazo ms (< 0 sem prazo, 0 sem bloquear); retorna 0, ou -1 se no enviou. */
+int mqueue_spsc_send(mqueue_t* queue, void* msg, int ms) {
+    int tail = queue->tail; // s o remetente escreve tail
+    unsigned int deadline = 0;
+
+    if (ms >= 0) {
+        deadline = systime() + ms;
+    }
+
+    while (mqueue_spsc_count(queue) == queue->maxMessages) {
+        if (ms == 0 || mqueue_spsc_wait(queue, 0, ms) < 0 || !(queue->active)) {
+            return -1;
+        }
+        if (ms > 0 && (ms = deadline - systime()) <= 0) {
+            ms = 0;
+        }
+    }
+
+    memcpy(queue->content + (tail % queue->maxMessages) * queue->messageSize, msg, queue->messageSize);
+    __atomic_store_n(&(queue->tail), (tail + 1) % (2 * queue->maxMessages), __ATOMIC_RELEASE);
+    mqueue_spsc_wake(queue, 1);
+
+    return 0;
+}
+
+/* Recebe com prazo ms, como mqueue_spsc_send. */
+int mqueue_spsc_recv(mqueue_t* queue, void* msg, int ms) {
+    int head = queue->head; // s o destinatrio escreve head
+    unsigned int deadline = 0;
+
+    if (ms >= 0) {
+        deadline = systime() + ms;
+    }
+
+    while (mqueue_spsc_count(queue) == 0) {
+        if (ms == 0 || mqueue_spsc_wait(queue, 1, ms) < 0 || !(queue->active)) {
+            return -1;
+        }
+        if (ms > 0 && (ms = deadline - systime()) <= 0) {
+            ms = 0;
+        }
+    }
+
+    memcpy(msg, queue->content + (head % queue->maxMessages) * queue->messageSize, queue->messageSize);
+    __atomic_store_n(&(queue->head), (head + 1) % (2 * queue->maxMessages), __ATOMIC_RELEASE);
+    mqueue_spsc_wake(queue, 0);
+
+    return 0;
+}
+
+/* sVaga conta os slots livres; um slot emprestado s volta a ele em mqueue_release. */
+void* mqueue_alloc(mqueue_t* queue) {
+    return mqueue_alloc_wait(queue, -1);
+}
+
+void* mqueue_alloc_wait(mqueue_t* queue, int ms) {
+    void* buf;
+
+    if (queue == NULL || !(queue->active) || queue->spsc) {
+        return NULL;
+    }
+
+    if (sem_down_wait(&(queue->sVaga), ms) == -1) return NULL;
+    if (sem_down(&(queue->sBuffer)) == -1) return NULL;
+
+    buf = mqueue_slot_take(queue, MQUEUE_SLOT_BORROWED);
+
+    sem_up(&(queue->sBuffer));
+
+    return buf;
+}
+
+int mqueue_slot(mqueue_t* queue, void* buf) {
+    long offset = (char*)buf - (char*)queue->content;
+
+    if (buf == NULL || offset < 0 || offset >= (long)queue->maxMessages * queue->messageSize || offset % queue->messageSize != 0) {
+        return -1;
+    }
+    return offset / queue->messageSize;
+}
+
+void* mqueue_slot_take(mqueue_t* queue, unsigned char state) {
+    void* buf = queue->freeSlots[--(queue->freeCount)];
+
+    queue->slotState[mqueue_slot(queue, buf)] = state;
+    return buf;
+}
+
+void mqueue_slot_put(mqueue_t* queue, void* buf) {
+    queue->slotState[mqueue_slot(queue, buf)] = MQUEUE_SLOT_FREE;
+    queue->freeSlots[(queue->freeCount)++] = buf;
+}
+
+void mqueue_ring_put(mqueue_t* queue, void* buf) {
+    /* S o apontador entra no buffer circular; h no mximo maxMessages slots, ento ele nunca enche. */
+    queue->slotState[mqueue_slot(queue, buf)] = MQUEUE_SLOT_QUEUED;
+    queue->ring[queue->tail] = buf;
+    queue->tail = (queue->tail + 1 == queue->maxMessages) ? 0 : queue->tail + 1;
+    ++(queue->countMessages);
+}
+
+void* mqueue_ring_get(mqueue_t* queue, unsigned char state) {
+    void* buf = queue->ring[queue->head];
+
+    queue->head = (queue->head + 1 == queue->maxMessages) ? 0 : queue->head + 1;
+    --(queue->countMessages);
+    queue->slotState[mqueue_slot(queue, buf)] = state;
+    return buf;
+}
+
+int mqueue_send_buf(mqueue_t* queue, void* buf) {
+    int slot;
+
+    if (queue == NULL || !(queue->active) || queue->spsc || (slot = mqueue_slot(queue, buf)) < 0) {
+        return -1;
+    }
+
+    if (sem_down(&(queue->sBuffer)) == -1) return -1;
+
+    /* S um slot emprestado por mqueue_alloc pode ser enviado. */
+    if (queue->slotState[slot] != MQUEUE_SLOT_BORROWED) {
+        sem_up(&(queue->sBuffer));
+        return -1;
+    }
+    mqueue_ring_put(queue, buf);
+
+    sem_up(&(queue->sBuffer));
+    sem_up(&(queue->sItem));
+
+    return 0;
+}
+
+void* mqueue_recv_buf(mqueue_t* queue) {
+    return mqueue_recv_buf_wait(queue, -1);
+}
+
+void* mqueue_recv_buf_wait(mqueue_t* queue, int ms) {
+    void* buf;
+
+    if (queue == NULL || !(queue->active) || queue->spsc) {
+        return NULL;
+    }
+
+    if (sem_down_wait(&(queue->sItem), ms) == -1) return NULL;
+    if (sem_down(&(queue->sBuffer)) == -1) return NULL;
+
+    buf = mqueue_ring_get(queue, MQUEUE_SLOT_BORROWED);
+
+    sem_up(&(queue->sBuffer));
+
+    return buf;
+}
+
+int mqueue_release(mqueue_t* queue, void* buf) {
+    int slot;
+
+    if (queue == NULL || !(queue->active) || queue->spsc || (slot = mqueue_slot(queue, buf)) < 0) {
+        return -1;
+    }
+
+    if (sem_down(&(queue->sBuffer)) == -1) return -1;
+
+    /* Um slot livre ou ainda na fila no pode ser devolvido (nem duas vezes o mesmo). */
+    if (queue->slotState[slot] != MQUEUE_SLOT_BORROWED) {
+        sem_up(&(queue->sBuffer));
+        return -1;
+    }
+    mqueue_slot_put(queue, buf);
+
+    sem_up(&(queue->sBuffer));
+    sem_up(&(queue->sVaga));
+
+    return 0;
+}
+
+/* As verses com cpia usam os mesmos slots, mas pegam o slot e o enfileiram (ou retiram e
+ * devolvem) numa s passagem por sBuffer, sem emprest-lo. */
+int mqueue_send(mqueue_t* queue, void* msg) {
+    return mqueue_send_wait(queue, msg, -1);
+}
+
+int mqueue_send_try(mqueue_t* queue, void* msg) {
+    return mqueue_send_wait(queue, msg, 0);
+}
+
+int mqueue_send_timed(mqueue_t* queue, void* msg, int ms) {
+    return mqueue_send_wait(queue, msg, (ms > 0) ? ms : 0);
+}
+
+int mqueue_send_wait(mqueue_t* queue, void* msg, int ms) {
+    void* buf;
+
+    if (queue != NULL && queue->active && queue->spsc) {
+        return mqueue_spsc_send(queue, msg, ms);
+    }
+
+    if (queue == NULL || !(queue->active)) {
         return -1;
     }
-    
-    preempcao = 0; // Impede preempo
-    s->queue = NULL;
-    s->value = value;
-    s->active = 1;
 
-    preempcao = 1; // Retoma preempo
-    if(remainingTicks <= 0) {
-        task_yield();
+    if (sem_down_wait(&(queue->sVaga), ms) == -1) return -1;
+    if (sem_down(&(queue->sBuffer)) == -1) return -1;
+
+    buf = mqueue_slot_take(queue, MQUEUE_SLOT_BORROWED);
+    memcpy(buf, msg, queue->messageSize);
+    mqueue_ring_put(queue, buf);
+
+    sem_up(&(queue->sBuffer));
+    sem_up(&(queue->sItem));
+
+    return 0;
+}
+
+int mqueue_recv(mqueue_t* queue, void* msg) {
+    return mqueue_recv_wait(queue, msg, -1);
+}
+
+int mqueue_recv_try(mqueue_t* queue, void* msg) {
+    return mqueue_recv_wait(queue, msg, 0);
+}
+
+int mqueue_recv_timed(mqueue_t* queue, void* msg, int ms) {
+    return mqueue_recv_wait(queue, msg, (ms > 0) ? ms : 0);
+}
+
+int mqueue_recv_wait(mqueue_t* queue, void* msg, int ms) {
+    void* buf;
+
+    if (queue != NULL && queue->active && queue->spsc) {
+        return mqueue_spsc_recv(queue, msg, ms);
+    }
+
+    if (queue == NULL || !(queue->active)) {
+        return -1;
     }
 
+    if (sem_down_wait(&(queue->sItem), ms) == -1) return -1;
+    if (sem_down(&(queue->sBuffer)) == -1) return -1;
+
+    buf = mqueue_ring_get(queue, MQUEUE_SLOT_BORROWED);
+    memcpy(msg, buf, queue->messageSize);
+    mqueue_slot_put(queue, buf);
+
+    sem_up(&(queue->sBuffer));
+    sem_up(&(queue->sVaga));
+
     return 0;
 }
 
-int sem_down(semaphore_t* s) {
-    if (s == NULL || !(s->active)) {
+/* Em lote, cada rodada paga uma s vez os semforos, para quantas mensagens couberem nela. */
+int mqueue_send_n(mqueue_t* queue, void* msgs, int n) {
+    int sent = 0, k, i;
+    void* buf;
+
+    if (queue == NULL || !(queue->active) || msgs == NULL || n < 0) {
         return -1;
     }
 
-    preempcao = 0; // Impede preempo
-    s->value--;
-    if (s->value < 0) {
-        // Caso no existam mais vagas no semforo, suspende a tarefa.
-        task_suspend(taskExec, &(s->queue));
+    // Se a fila for destruda no meio, as mensagens j enfileiradas so informadas no retorno.
+    if (queue->spsc) {
+        for (; sent < n; sent++) {
+            if (mqueue_spsc_send(queue, msgs + sent * queue->messageSize, -1) == -1) break;
+        }
+        return (sent > 0 || n == 0) ? sent : -1;
+    }
 
-        preempcao = 1; // Retoma preempo
-        task_yield();
+    while (sent < n) {
+        if ((k = sem_down_upto(&(queue->sVaga), n - sent)) == -1) break;
+        if (sem_down(&(queue->sBuffer)) == -1) break;
 
-        // Se a tarefa foi acordada devido a um sem_destroy, retorna -1.
-        if (!(s->active)) {
-            return -1;
+        for (i = 0; i < k; i++, sent++) {
+            buf = mqueue_slot_take(queue, MQUEUE_SLOT_BORROWED);
+            memcpy(buf, msgs + sent * queue->messageSize, queue->messageSize);
+            mqueue_ring_put(queue, buf);
         }
-        
+
+        sem_up(&(queue->sBuffer));
+        sem_up_n(&(queue->sItem), k);
+    }
+
+    return (sent > 0 || n == 0) ? sent : -1;
+}
+
+int mqueue_recv_n(mqueue_t* queue, void* msgs, int n) {
+    int k, i;
+    void* buf;
+
+    if (queue == NULL || !(queue->active) || msgs == NULL || n < 0) {
+        return -1;
+    }
+    if (n == 0) {
         return 0;
     }
-    
-    preempcao = 1; // Retoma preempo
-    if(remainingTicks <= 0) {
-        task_yield();
+
+    if (queue->spsc) {
+        // Espera pela primeira mensagem e leva as que j estiverem na fila.
+        if (mqueue_spsc_recv(queue, msgs, -1) == -1) return -1;
+        for (k = 1; k < n && mqueue_spsc_recv(queue, msgs + k * queue->messageSize, 0) == 0; k++);
+        return k;
     }
-    return 0;
+
+    if ((k = sem_down_upto(&(queue->sItem), n)) == -1) return -1;
+    if (sem_down(&(queue->sBuffer)) == -1) return -1;
+
+    for (i = 0; i < k; i++) {
+        buf = mqueue_ring_get(queue, MQUEUE_SLOT_BORROWED);
+        memcpy(msgs + i * queue->messageSize, buf, queue->messageSize);
+        mqueue_slot_put(queue, buf);
+    }
+
+    sem_up(&(queue->sBuffer));
+    sem_up_n(&(queue->sVaga), k);
+
+    return k;
 }
 
-int sem_up(semaphore_t* s) {
-    if (s == NULL || !(s->active)) {
+int mqueue_destroy(mqueue_t* queue) {
+    KERNEL_LOCK();
+    if (queue == NULL || !(queue->active)) {
+        KERNEL_UNLOCK();
         return -1;
     }
     
-    preempcao = 0; // Impede preempo
-    s->value++;
-    if (s->value <= 0) {
-        task_resume(s->queue);
+    queue->active = 0;
+    free(queue->content);
+    free(queue->ring);
+    free(queue->freeSlots);
+    free(queue->slotState);
+    if (queue->spsc) {
+        if (queue->spscWait[0] != NULL) task_resume(queue->spscWait[0]);
+        if (queue->spscWait[1] != NULL) task_resume(queue->spscWait[1]);
     }
-    preempcao = 1; // Retoma preempo
-    
-    if(remainingTicks <= 0) {
-        task_yield();
+    else {
+        sem_destroy(&(queue->sBuffer));
+        sem_destroy(&(queue->sItem));
+        sem_destroy(&(queue->sVaga));
     }
+    
+    KERNEL_UNLOCK();
     return 0;
 }
 
-int sem_destroy(semaphore_t* s) {
-    if (s == NULL || !(s->active)) {
+int mqueue_msgs(mqueue_t* queue) {
+    KERNEL_LOCK();
+    if (queue == NULL || !(queue->active)) {
+        KERNEL_UNLOCK();
         return -1;
     }
-    
-    preempcao = 0; // Impede preempo
-    s->active = 0;
-    while (s->queue != NULL) {
-        task_resume(s->queue);
-    }
 
-    preempcao = 1; // Retoma preempo
-    if(remainingTicks <= 0) {
-        task_yield();
+    KERNEL_UNLOCK();
+    if (queue->spsc) {
+        return mqueue_spsc_count(queue);
     }
-    return 0;
+    return queue->countMessages;
 }
 
-int mutex_create(mutex_t* m) {
-    if (m == NULL) {
+int diskdriver_init(int* numBlocks, int* blockSize) {
+    return diskdriver_init_sched(numBlocks, blockSize, DISK_SCHED);
+}
+
+int diskdriver_init_sched(int* numBlocks, int* blockSize, int sched) {
+    int qtdBlocos;
+    int tamBloco;
+
+    if (sched < DISK_SCHED_FCFS || sched > DISK_SCHED_CSCAN) {
+        return -1;
+    }
+    if (disk_cmd(DISK_CMD_INIT, 0, NULL) < 0) {
+        return -1;
+    }
+    qtdBlocos = disk_cmd(DISK_CMD_DISKSIZE, 0, NULL);
+    tamBloco = disk_cmd(DISK_CMD_BLOCKSIZE, 0, NULL);
+    if (qtdBlocos < 0 || tamBloco < 0) {
         return -1;
     }
 
-    preempcao = 0; // Impede preempo
-    m->queue = NULL;
-    m->value = 1;
-    m->active = 1;
-    preempcao = 1; // Retoma preempo
+    *numBlocks = qtdBlocos;
+    *blockSize = tamBloco;
 
-    if (remainingTicks <= 0) {
-        task_yield();
+    disco.numBlocks = qtdBlocos;
+    disco.blockSize = tamBloco;
+    disco.diskQueue = NULL;
+    disco.requestQueue = NULL;
+    disco.current = NULL;
+    disco.livre = 1;
+    disco.sinal = 0;
+
+    disco.sched = sched;
+    disco.head = 0; // O disco simulado comea no bloco 0.
+    disco.direction = 1;
+    disco.requests = 0;
+    disco.commands = 0;
+    disco.headMovement = 0;
+    disco.latencyTotal = 0;
+    
+    sem_create(&(disco.semaforo), 1);
+
+    disco.cache = NULL;
+    disco.cacheHash = NULL;
+    disco.cacheData = NULL;
+    disco.cacheSize = 0;
+    disco.cacheHits = 0;
+    disco.cacheMisses = 0;
+    disco.flushBatch = NULL;
+    disco.flushBuffer = malloc(DISK_FLUSH_RUN * tamBloco);
+    disco.writeback = (DISK_CACHE_MODE == DISK_CACHE_WRITEBACK && disco.flushBuffer != NULL);
+    disco.dirtyCount = 0;
+    disco.flushQueue = NULL;
+    disco.prefetchQueue = NULL;
+    disco.prefetchCount = 0;
+    disco.prefetchWait = NULL;
+    disco.prefetchIssued = 0;
+    disco.prefetchUsed = 0;
+    mutex_create(&(disco.flushLock));
+    disk_cache_size(DISK_CACHE_BLOCKS); // Sem memria, o disco funciona sem a cache.
+
+    /* A tarefa de gravao  do ncleo: no desloca os ids das tarefas de usurio. */
+    if (kernel_task_create(&taskDiskFlusher, &bodyDiskFlusher, NULL) < 0) {
+        return -1;
     }
 
     return 0;
 }
 
-int mutex_lock(mutex_t* m) {
-    if (m == NULL || !(m->active)) {
-        return -1;
+int disk_block_read(int block, void* buffer) {
+    return disk_request(DISK_REQUEST_READ, block, buffer, -1);
+}
+
+int disk_block_write(int block, void* buffer) {
+    return disk_request(DISK_REQUEST_WRITE, block, buffer, -1);
+}
+
+int disk_block_readv(int block, int count, void* buffer) {
+    return disk_request_v(DISK_REQUEST_READ, block, count, buffer);
+}
+
+int disk_block_writev(int block, int count, void* buffer) {
+    return disk_request_v(DISK_REQUEST_WRITE, block, count, buffer);
+}
+
+int disk_block_read_timed(int block, void* buffer, int ms) {
+    return disk_request(DISK_REQUEST_READ, block, buffer, (ms > 0) ? ms : 0);
+}
+
+int disk_block_write_timed(int block, void* buffer, int ms) {
+    return disk_request(DISK_REQUEST_WRITE, block, buffer, (ms > 0) ? ms : 0);
+}
+
+void disk_stats(long* requests, long* headMovement, long* avgLatency) {
+    KERNEL_LOCK();
+    if (requests != NULL) {
+        *requests = disco.requests;
+    }
+    if (headMovement != NULL) {
+        *headMovement = disco.headMovement;
+    }
+    if (avgLatency != NULL) {
+        *avgLatency = (disco.requests > 0) ? disco.latencyTotal / disco.requests : 0;
     }
+    KERNEL_UNLOCK();
+}
 
-    preempcao = 0; // Impede preempo
+void disk_command_stats(long* commands) {
+    KERNEL_LOCK();
+    if (commands != NULL) {
+        *commands = disco.commands;
+    }
+    KERNEL_UNLOCK();
+}
 
-    if (m->value == 0) { // Se j estiver travado, suspende a task
-        task_suspend(taskExec, &(m->queue));
+int disk_cache_size(int blocks) {
+    int i;
 
-        preempcao = 1; // Retoma preempo
-        task_yield();
+    if (blocks < 0 || disco.numBlocks == 0) {
+        return -1;
+    }
 
-        // Se a tarefa foi acordada devido a um mutex_destroy, retorna -1.
-        if (!(m->active)) {
+    KERNEL_LOCK();
+    /* Os blocos sujos so gravados antes de a cache ser descartada. */
+    mutex_lock(&(disco.flushLock));
+    while (disco.dirtyCount > 0) {
+        if (disk_flush() < 0) {
+            mutex_unlock(&(disco.flushLock));
+            KERNEL_UNLOCK();
             return -1;
         }
+    }
 
+    free(disco.cache);
+    free(disco.cacheHash);
+    free(disco.cacheData);
+    free(disco.flushBatch);
+    disco.cache = NULL;
+    disco.cacheHash = NULL;
+    disco.cacheData = NULL;
+    disco.flushBatch = NULL;
+    disco.cacheLRU = NULL;
+    disco.cacheFree = NULL;
+    disco.cacheSize = 0;
+
+    if (blocks == 0) {
+        mutex_unlock(&(disco.flushLock));
+        KERNEL_UNLOCK();
         return 0;
     }
 
-    m->value = 0; // Se no estiver travado, trava e obtm o mutex.
+    disco.cache = malloc(blocks * sizeof(cacheblock_t));
+    disco.cacheHash = calloc(blocks, sizeof(cacheblock_t*));
+    disco.cacheData = malloc((size_t) blocks * disco.blockSize);
+    disco.flushBatch = malloc(blocks * sizeof(cacheblock_t*));
+    if (disco.cache == NULL || disco.cacheHash == NULL || disco.cacheData == NULL || disco.flushBatch == NULL) {
+        free(disco.cache);
+        free(disco.cacheHash);
+        free(disco.cacheData);
+        free(disco.flushBatch);
+        disco.cache = NULL;
+        disco.cacheHash = NULL;
+        disco.cacheData = NULL;
+        disco.flushBatch = NULL;
+        mutex_unlock(&(disco.flushLock));
+        KERNEL_UNLOCK();
+        return -1;
+    }
 
-    preempcao = 1; // Retoma preempo
-    if (remainingTicks <= 0) {
-        task_yield();
+    for (i = 0; i < blocks; i++) {
+        disco.cache[i].prev = NULL;
+        disco.cache[i].next = NULL;
+        disco.cache[i].queue = NULL;
+        disco.cache[i].hashNext = NULL;
+        disco.cache[i].block = -1;
+        disco.cache[i].data = (char*) disco.cacheData + (size_t) i * disco.blockSize;
+        disco.cache[i].dirty = 0;
+        disco.cache[i].flushing = 0;
+        disco.cache[i].prefetched = 0;
+        queue_append_owned((queue_owned_t**)&(disco.cacheFree), (queue_owned_t*)&(disco.cache[i]));
     }
+    disco.cacheSize = blocks;
+
+    mutex_unlock(&(disco.flushLock));
+    KERNEL_UNLOCK();
     return 0;
 }
 
-int mutex_unlock(mutex_t* m) {
-    if (m == NULL || !(m->active)) {
+int disk_cache_mode(int mode) {
+    if (mode != DISK_CACHE_WRITETHROUGH && mode != DISK_CACHE_WRITEBACK) {
+        return -1;
+    }
+    if (mode == DISK_CACHE_WRITEBACK && disco.flushBuffer == NULL) {
         return -1;
     }
 
-    preempcao = 0; // Impede preempo
+    KERNEL_LOCK();
+    if (mode == DISK_CACHE_WRITETHROUGH) {
+        /* Escritas feitas durante a gravao ainda sujam blocos; s troca de modo sem nenhum. */
+        mutex_lock(&(disco.flushLock));
+        while (disco.dirtyCount > 0) {
+            if (disk_flush() < 0) {
+                mutex_unlock(&(disco.flushLock));
+                KERNEL_UNLOCK();
+                return -1;
+            }
+        }
+        mutex_unlock(&(disco.flushLock));
+    }
+    disco.writeback = mode;
 
-    if (m->queue != NULL) { // Se alguma task estiver esperando na fila, mantm o mutex travado (para a prxima task) e acorda a primeira task da fila.
-        task_resume(m->queue);
+    KERNEL_UNLOCK();
+    return 0;
+}
+
+int disk_sync() {
+    int result;
+
+    KERNEL_LOCK();
+    /* Uma gravao em andamento pode ter tirado blocos do estado sujo sem ainda t-los gravado:
+     * esperar por flushLock garante que ela terminou. */
+    mutex_lock(&(disco.flushLock));
+    result = disk_flush();
+    mutex_unlock(&(disco.flushLock));
+
+    KERNEL_UNLOCK();
+    return result;
+}
+
+int disk_flush() {
+    cacheblock_t* entry;
+    int block;
+    int count;
+    int run;
+    int result;
+    int i;
+    int j;
+
+    if (disco.dirtyCount == 0) {
+        return 0;
     }
-    else { // Se no tiver nenhuma task esperando, libera o mutex.
-        m->value = 1;
+
+    count = 0;
+    for (i = 0; i < disco.cacheSize; i++) {
+        if (disco.cache[i].dirty) {
+            disco.flushBatch[count++] = &(disco.cache[i]);
+        }
+    }
+    /* Em ordem crescente de bloco, o lote  gravado numa s passada da cabea. */
+    qsort(disco.flushBatch, count, sizeof(cacheblock_t*), cache_block_cmp);
+
+    result = 0;
+    for (i = 0; i < count; i += run) {
+        entry = disco.flushBatch[i];
+        if (!entry->dirty) {
+            run = 1;
+            continue;
+        }
+
+        /* Os blocos sujos seguintes que continuam a sequncia vo no mesmo pedido. Cada bloco 
+         * copiado e deixa de estar sujo antes da gravao: uma escrita feita durante ela o suja de
+         * novo, e ele entra no prximo lote. */
+        block = entry->block;
+        for (run = 0; i + run < count && run < DISK_FLUSH_RUN; run++) {
+            entry = disco.flushBatch[i + run];
+            if (!entry->dirty || entry->block != block + run) {
+                break;
+            }
+            memcpy((char*)disco.flushBuffer + run * disco.blockSize, entry->data, disco.blockSize);
+            entry->dirty = 0;
+            entry->flushing = 1;
+            disco.dirtyCount--;
+        }
+
+        if (disk_io(DISK_REQUEST_WRITE, block, run, disco.flushBuffer, -1) < 0) {
+            for (j = 0; j < run; j++) {
+                entry = disco.flushBatch[i + j];
+                if (entry->block == block + j && !entry->dirty) {
+                    entry->dirty = 1;
+                    disco.dirtyCount++;
+                }
+            }
+            result = -1;
+        }
+        for (j = 0; j < run; j++) {
+            disco.flushBatch[i + j]->flushing = 0;
+        }
+    }
+
+    return result;
+}
+
+int cache_block_cmp(const void* a, const void* b) {
+    return (*(cacheblock_t**)a)->block - (*(cacheblock_t**)b)->block;
+}
+
+int disk_flush_pending() {
+    return disco.dirtyCount > 0 || disco.flushLock.owner != NULL;
+}
+
+void disk_flush_wake() {
+    if (taskDiskFlusher.queue == &(disco.flushQueue)) {
+        task_resume(&taskDiskFlusher);
+    }
+}
+
+void bodyDiskFlusher(void* arg) {
+    while (1) {
+        KERNEL_LOCK();
+        /* Sem blocos sujos, espera a primeira escrita adiada. */
+        if (disco.dirtyCount == 0) {
+            task_block(&(disco.flushQueue), -1);
+        }
+
+        /* D tempo para outras escritas entrarem no lote, a menos que a cache esteja ficando cheia
+         * de blocos sujos ou que no haja mais tarefas de usurio. */
+        if (disco.dirtyCount < disco.cacheSize / 2 && countTasks > 0) {
+            task_block(&(disco.flushQueue), DISK_FLUSH_MS);
+        }
+
+        mutex_lock(&(disco.flushLock));
+        disk_flush();
+        mutex_unlock(&(disco.flushLock));
+        KERNEL_UNLOCK();
+    }
+}
+
+void disk_cache_stats(long* hits, long* misses) {
+    KERNEL_LOCK();
+    if (hits != NULL) {
+        *hits = disco.cacheHits;
+    }
+    if (misses != NULL) {
+        *misses = disco.cacheMisses;
+    }
+    KERNEL_UNLOCK();
+}
+
+cacheblock_t* cache_find(int block) {
+    cacheblock_t* entry;
+
+    if (disco.cacheSize == 0) {
+        return NULL;
+    }
+
+    for (entry = disco.cacheHash[block % disco.cacheSize]; entry != NULL; entry = entry->hashNext) {
+        if (entry->block == block) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+cacheblock_t* cache_lookup(int block) {
+    cacheblock_t* entry;
+
+    entry = cache_find(block);
+    if (entry != NULL) {
+        /* Passa para o fim da lista LRU (mais recentemente usada). */
+        queue_remove_owned((queue_owned_t*)entry);
+        queue_append_owned((queue_owned_t**)&(disco.cacheLRU), (queue_owned_t*)entry);
+    }
+    return entry;
+}
+
+cacheblock_t* cache_insert(int block, void* data) {
+    cacheblock_t* entry;
+    cacheblock_t** link;
+
+    if (disco.cacheSize == 0) {
+        return NULL;
+    }
+
+    entry = cache_lookup(block);
+    if (entry == NULL) {
+        /* Usa uma entrada livre ou, com a cache cheia, a menos recentemente usada que no precise
+         * ser gravada. */
+        entry = disco.cacheFree;
+        if (entry == NULL) {
+            entry = disco.cacheLRU;
+            while (entry->dirty || entry->flushing) {
+                entry = entry->next;
+                if (entry == disco.cacheLRU) {
+                    return NULL;
+                }
+            }
+        }
+        queue_remove_owned((queue_owned_t*)entry);
+        if (entry->block >= 0) {
+            link = &(disco.cacheHash[entry->block % disco.cacheSize]);
+            while (*link != entry) {
+                link = &((*link)->hashNext);
+            }
+            *link = entry->hashNext;
+        }
+
+        entry->block = block;
+        entry->prefetched = 0;
+        entry->hashNext = disco.cacheHash[block % disco.cacheSize];
+        disco.cacheHash[block % disco.cacheSize] = entry;
+        queue_append_owned((queue_owned_t**)&(disco.cacheLRU), (queue_owned_t*)entry);
+    }
+    memcpy(entry->data, data, disco.blockSize);
+    return entry;
+}
+
+cacheblock_t* cache_fill(int block, void* data) {
+    cacheblock_t* entry;
+
+    /* Uma escrita em write-back feita enquanto a leitura estava no disco s marcou a entrada como
+     * suja, sem ir  fila do disco: o contedo lido  mais antigo que ela. */
+    entry = cache_find(block);
+    if (entry != NULL && (entry->dirty || entry->flushing)) {
+        return NULL;
+    }
+    return cache_insert(block, data);
+}
+
+void cache_invalidate(int block) {
+    cacheblock_t* entry;
+    cacheblock_t** link;
+
+    if (disco.cacheSize == 0) {
+        return;
+    }
+
+    for (link = &(disco.cacheHash[block % disco.cacheSize]); *link != NULL; link = &((*link)->hashNext)) {
+        entry = *link;
+        if (entry->block == block) {
+            if (entry->dirty) {
+                entry->dirty = 0;
+                disco.dirtyCount--;
+            }
+            *link = entry->hashNext;
+            entry->hashNext = NULL;
+            entry->block = -1;
+            queue_remove_owned((queue_owned_t*)entry);
+            queue_append_owned((queue_owned_t**)&(disco.cacheFree), (queue_owned_t*)entry);
+            return;
+        }
+    }
+}
+
+int disk_write_pending(int block) {
+    diskrequest_t* request;
+
+    for (request = disco.current; request != NULL; request = request->batchNext) {
+        if (request->operation == DISK_REQUEST_WRITE && block >= request->block && block < request->block + request->count) {
+            return 1;
+        }
+    }
+    request = disco.requestQueue;
+    if (request != NULL) {
+        do {
+            if (request->operation == DISK_REQUEST_WRITE && block >= request->block && block < request->block + request->count) {
+                return 1;
+            }
+            request = request->next;
+        } while (request != disco.requestQueue);
     }
+    return 0;
+}
 
-    preempcao = 1; // Retoma preempo
-    if (remainingTicks <= 0) {
-        task_yield();
+void cache_dirty(cacheblock_t* entry) {
+    if (!entry->dirty) {
+        entry->dirty = 1;
+        disco.dirtyCount++;
+        if (disco.dirtyCount == 1 || disco.dirtyCount >= disco.cacheSize / 2) {
+            disk_flush_wake();
+        }
     }
-    return 0;
 }
 
-int mutex_destroy(mutex_t* m) {
-    if (m == NULL || !(m->active)) {
+/* Leituras so atendidas pela cache quando possvel; escritas atualizam a cache antes de irem ao
+ * disco (ou, em write-back, em vez de irem), para que as leituras seguintes j vejam o novo
+ * contedo. Pedidos ao mesmo bloco so atendidos pelo disco na ordem de chegada, qualquer que
+ * seja a poltica de escalonamento. */
+int disk_request(unsigned char operation, int block, void* buffer, int ms) {
+    cacheblock_t* entry;
+    task_t* task;
+    unsigned int deadline;
+    int useful;
+    int result;
+
+    if (block < 0 || block >= disco.numBlocks || buffer == NULL) {
         return -1;
     }
 
-    preempcao = 0; // Impede preempo
-    m->active = 0;
-    while (m->queue != NULL) {
-        task_resume(m->queue);
-    }
+    KERNEL_LOCK();
+    /* O prazo vale para o pedido todo: cada espera usa s o que resta dele. */
+    deadline = systime() + ms;
+    if (operation == DISK_REQUEST_READ) {
+        task = this_core()->taskExec;
 
-    preempcao = 1; // Retoma preempo
-    if (remainingTicks <= 0) {
-        task_yield();
-    }
-    return 0;
-}
+        useful = disk_prefetch_wait(block, &ms, deadline);
+        if (useful < 0) {
+            KERNEL_UNLOCK();
+            return -1;
+        }
 
-int barrier_create(barrier_t* b, int N) {
-    if (b == NULL || N <= 0) {
-        return -1;
+        entry = cache_lookup(block);
+        if (entry != NULL) {
+            memcpy(buffer, entry->data, disco.blockSize);
+            disco.cacheHits++;
+            if (entry->prefetched) {
+                entry->prefetched = 0;
+                disco.prefetchUsed++;
+                useful = 1;
+            }
+            disk_readahead(task, block, 1, useful);
+            KERNEL_UNLOCK();
+            return 0;
+        }
+        if (disco.cacheSize > 0) {
+            disco.cacheMisses++;
+        }
+        disk_readahead(task, block, 1, 0);
     }
-    
-    preempcao = 0; // Impede preempo
-    b->maxTasks = N;
-    b->countTasks = 0;
-    b->active = 1;
-    
-    preempcao = 1; // Retoma preempo
-    if(remainingTicks <= 0) {
-        task_yield();
+    else {
+        entry = cache_insert(block, buffer);
+        if (entry != NULL && disco.writeback) {
+            /* Escrita adiada: o bloco fica sujo na cache at a tarefa de gravao lev-lo ao disco. */
+            cache_dirty(entry);
+            KERNEL_UNLOCK();
+            return 0;
+        }
     }
-    return 0;
+
+    result = disk_io_cached(operation, block, 1, buffer, ms);
+
+    KERNEL_UNLOCK();
+    return result;
 }
 
-int barrier_join(barrier_t* b) {
-    if (b == NULL || !(b->active)) {
+int disk_request_v(unsigned char operation, int block, int count, void* buffer) {
+    cacheblock_t* entry;
+    char* data;
+    int start;
+    int cached;
+    int useful;
+    int result;
+    int ms;
+    int i;
+
+    if (count < 1 || block < 0 || block > disco.numBlocks - count || buffer == NULL) {
         return -1;
     }
-    
-    preempcao = 0; // Impede preempo
-    b->countTasks++;
 
-    if (b->countTasks == b->maxTasks) {
-        while (b->queue != NULL) {
-            task_resume(b->queue);
+    KERNEL_LOCK();
+    data = buffer;
+    result = 0;
+    useful = 0;
+    start = -1; // Primeiro bloco (relativo a block) do trecho que vai ao disco, ou -1.
+    for (i = 0; i <= count; i++) {
+        cached = 0;
+        if (i < count && operation == DISK_REQUEST_READ) {
+            /* Como em disk_request, um bloco sendo lido antecipadamente  esperado, no lido de novo. */
+            ms = -1;
+            if (disk_prefetch_wait(block + i, &ms, 0) > 0) {
+                useful = 1;
+            }
+            entry = cache_lookup(block + i);
+            if (entry != NULL) {
+                memcpy(data + i * disco.blockSize, entry->data, disco.blockSize);
+                disco.cacheHits++;
+                if (entry->prefetched) {
+                    entry->prefetched = 0;
+                    disco.prefetchUsed++;
+                    useful = 1;
+                }
+                cached = 1;
+            }
+            else if (disco.cacheSize > 0) {
+                disco.cacheMisses++;
+            }
         }
-        b->countTasks = 0;
-        preempcao = 1; // Retoma preempo
-        if(remainingTicks <= 0) {
-            task_yield();
+        else if (i < count) {
+            entry = cache_insert(block + i, data + i * disco.blockSize);
+            if (entry != NULL && disco.writeback) {
+                cache_dirty(entry);
+                cached = 1;
+            }
+        }
+
+        /* O trecho termina no primeiro bloco atendido pela cache ou no fim do pedido. */
+        if (i < count && !cached) {
+            if (start < 0) {
+                start = i;
+            }
+        }
+        else if (start >= 0) {
+            if (disk_io_cached(operation, block + start, i - start, data + start * disco.blockSize, -1) < 0) {
+                result = -1;
+            }
+            start = -1;
         }
-        return 0;
     }
 
-    task_suspend(taskExec, &(b->queue));
-    preempcao = 1; // Retoma preempo
-    task_yield();
-    
-    if(!(b->active)) {
-        return -1;
+    /* A leitura continua (ou inicia) um fluxo sequencial, e a leitura antecipada segue alm dela. */
+    if (operation == DISK_REQUEST_READ && result == 0) {
+        disk_readahead(this_core()->taskExec, block, count, useful);
     }
-    return 0;
+
+    KERNEL_UNLOCK();
+    return result;
 }
 
-int barrier_destroy(barrier_t* b) {
-    if (b == NULL || !(b->active)) {
-        return -1;
-    }
-    
-    preempcao = 0; // Impede preempo
-    b->active = 0;
-    while (b->queue != NULL) {
-        task_resume(b->queue);
-    }
+int disk_prefetch_wait(int block, int* ms, unsigned int deadline) {
+    int waited = 0;
 
-    preempcao = 1; // Retoma preempo
-    if(remainingTicks <= 0) {
-        task_yield();
+    /* Cada leitura antecipada concluda acorda todas as tarefas em prefetchWait: a que esperava outro
+     * bloco volta a esperar, com o prazo que sobrou. */
+    while (*ms != 0 && cache_find(block) == NULL && disk_prefetch_find(block, 1) != NULL) {
+        if (task_block(&(disco.prefetchWait), *ms) < 0) {
+            return -1;
+        }
+        waited = 1;
+        if (*ms > 0 && (*ms = deadline - systime()) <= 0) {
+            *ms = 0;
+        }
     }
-    return 0;
+    return waited;
 }
 
-int mqueue_create(mqueue_t* queue, int max, int size) {
-    if(queue == NULL) {
-        return -1;
-    }
-    
-    preempcao = 0; // Impede preempo
-    
-    queue->content = malloc(max * size);
-    queue->messageSize = size;
-    queue->maxMessages = max;
-    queue->countMessages = 0;
-    
-    sem_create(&(queue->sBuffer), 1);
-    sem_create(&(queue->sItem), 0);
-    sem_create(&(queue->sVaga), max);
-    
-    queue->active = 1;
-    
-    preempcao = 1; // Retoma preempo
-    if(remainingTicks <= 0) {
-        task_yield();
+int disk_io_cached(unsigned char operation, int block, int count, void* buffer, int ms) {
+    int result;
+    int i;
+
+    result = disk_io(operation, block, count, buffer, ms);
+
+    for (i = 0; i < count; i++) {
+        if (operation == DISK_REQUEST_READ) {
+            /* Uma escrita do bloco que chegou depois desta leitura j atualizou a cache (e pode ter
+             * perdido a entrada para outro bloco): o contedo lido  mais antigo e no  guardado. */
+            if (result == 0 && !disk_write_pending(block + i)) {
+                cache_fill(block + i, (char*)buffer + i * disco.blockSize);
+            }
+        }
+        else if (result < 0) {
+            /* A escrita no foi feita: a cpia na cache no corresponde mais ao disco. */
+            cache_invalidate(block + i);
+        }
     }
-    return 0;
+    return result;
 }
 
-int mqueue_send(mqueue_t* queue, void* msg) {
-    if (queue == NULL || !(queue->active)) {
+/* O pedido fica na pilha da tarefa, que s retorna depois que ele sai da fila e do disco. */
+int disk_io(unsigned char operation, int block, int count, void* buffer, int ms) {
+    diskrequest_t request;
+
+    KERNEL_LOCK();
+    if (sem_down(&(disco.semaforo)) < 0) {
+        KERNEL_UNLOCK();
         return -1;
     }
-    
-    if (sem_down(&(queue->sVaga)) == -1) return -1;
-    if (sem_down(&(queue->sBuffer)) == -1) return -1;
-    
-    memcpy(queue->content + queue->countMessages * queue->messageSize, msg, queue->messageSize);
-    ++(queue->countMessages);
-        
-    sem_up(&(queue->sBuffer));
-    sem_up(&(queue->sItem));
-    
-    return 0;
-}
 
-int mqueue_recv(mqueue_t* queue, void* msg) {
-    if (queue == NULL || !(queue->active)) {
-        return -1;
+    request.task = this_core()->taskExec;
+    request.operation = operation;
+    request.block = block;
+    request.count = count;
+    request.buffer = buffer;
+    request.done = 0;
+    request.failed = 0;
+    request.arrival = systime();
+    request.batchNext = NULL;
+    request.next = NULL;
+    request.prev = NULL;
+
+    queue_append((queue_t**)&(disco.requestQueue), (queue_t*)&request);
+
+    if (taskDiskMgr.estado == 's') {
+        task_resume(&taskDiskMgr);
     }
-    
-    if (sem_down(&(queue->sItem)) == -1) return -1;
-    if (sem_down(&(queue->sBuffer)) == -1) return -1;
-    
-    --(queue->countMessages);
-    memcpy(msg, queue->content, queue->messageSize);
-    memmove(queue->content, queue->content + queue->messageSize, queue->countMessages * queue->messageSize);
-    
-    sem_up(&(queue->sBuffer));
-    sem_up(&(queue->sVaga));
-    
-    return 0;
-}
 
-int mqueue_destroy(mqueue_t* queue) {
-    if (queue == NULL || !(queue->active)) {
+    if (sem_up(&(disco.semaforo))) {
+        KERNEL_UNLOCK();
         return -1;
     }
-    
-    queue->active = 0;
-    free(queue->content);
-    sem_destroy(&(queue->sBuffer));
-    sem_destroy(&(queue->sItem));
-    sem_destroy(&(queue->sVaga));
-    
-    return 0;
-}
 
-int mqueue_msgs(mqueue_t* queue) {
-    if (queue == NULL || !(queue->active)) {
-        return -1;
+    /* O gerenciador marca done e acorda a tarefa, se ela estiver em diskQueue; por isso done 
+     * conferido dentro da seo crtica, antes de cada suspenso. */
+    while (1) {
+        if (request.done) {
+            break;
+        }
+        if (task_block(&(disco.diskQueue), ms) < 0 && !request.done) {
+            if (sem_down(&(disco.semaforo)) < 0) {
+                KERNEL_UNLOCK();
+                return -1;
+            }
+            if (request.next != NULL) {
+                // Prazo vencido com o pedido ainda na fila: cancela-o.
+                queue_remove((queue_t**)&(disco.requestQueue), (queue_t*)&request);
+                sem_up(&(disco.semaforo));
+                KERNEL_UNLOCK();
+                return -1;
+            }
+            sem_up(&(disco.semaforo));
+            // O disco j est atendendo o pedido e usando o buffer: espera o trmino.
+            ms = -1;
+        }
     }
 
-    return queue->countMessages;
+    KERNEL_UNLOCK();
+    return request.failed ? -1 : 0;
 }
 
-int diskdriver_init(int* numBlocks, int* blockSize) {
-    int qtdBlocos;
-    int tamBloco;
+void disk_readahead(task_t* task, int block, int count, int useful) {
+    readstream_t* stream;
+    int i;
+    int dir;
 
-    if (disk_cmd(DISK_CMD_INIT, 0, NULL) < 0) {
-        return -1;
-    }
-    qtdBlocos = disk_cmd(DISK_CMD_DISKSIZE, 0, NULL);
-    tamBloco = disk_cmd(DISK_CMD_BLOCKSIZE, 0, NULL);
-    if (qtdBlocos < 0 || tamBloco < 0) {
-        return -1;
+    if (READAHEAD_MAX <= 0 || disco.cacheSize == 0) {
+        return;
     }
 
-    *numBlocks = qtdBlocos;
-    *blockSize = tamBloco;
-
-    disco.numBlocks = qtdBlocos;
-    disco.blockSize = tamBloco;
-    disco.diskQueue = NULL;
-    disco.requestQueue = NULL;
-    disco.livre = 1;
-    disco.sinal = 0;
-    
-    sem_create(&(disco.semaforo), 1);
+    /* Procura o fluxo de que os blocos so a continuao (comeam logo acima do ltimo bloco lido
+     * num fluxo crescente, ou terminam logo abaixo dele num decrescente); se no houver, eles
+     * iniciam um fluxo no lugar do usado h mais tempo. */
+    stream = NULL;
+    dir = 0;
+    for (i = 0; i < READ_STREAMS; i++) {
+        if (task->readStreams[i].dir >= 0 && block == task->readStreams[i].last + 1) {
+            dir = 1;
+        }
+        else if (task->readStreams[i].dir <= 0 && block + count == task->readStreams[i].last) {
+            dir = -1;
+        }
+        else {
+            continue;
+        }
+        stream = &(task->readStreams[i]);
+        break;
+    }
+    if (stream == NULL) {
+        stream = &(task->readStreams[0]);
+        for (i = 1; i < READ_STREAMS; i++) {
+            if (task->readStreams[i].lastUse < stream->lastUse) {
+                stream = &(task->readStreams[i]);
+            }
+        }
+        stream->last = block + count - 1;
+        stream->dir = 0;
+        stream->window = 0;
+        stream->lastUse = systime();
+        return;
+    }
+    stream->last = (dir > 0) ? block + count - 1 : block;
+    stream->dir = dir;
+    stream->lastUse = systime();
+
+    /* A janela cresce enquanto os blocos antecipados so usados e diminui quando o fluxo precisa
+     * ir ao disco mesmo assim (o bloco antecipado foi descartado da cache antes do uso). */
+    if (stream->window == 0) {
+        stream->window = READAHEAD_MIN;
+    }
+    else if (useful) {
+        stream->window = (stream->window * 2 < READAHEAD_MAX) ? stream->window * 2 : READAHEAD_MAX;
+    }
+    else {
+        stream->window = (stream->window / 2 > READAHEAD_MIN) ? stream->window / 2 : READAHEAD_MIN;
+    }
 
-    return 0;
+    /* Com pedidos de outras tarefas na fila o disco j est ocupado, e um bloco antecipado que no
+     * for usado s atrasaria esses pedidos. As leituras antecipadas em andamento ocupam no mximo
+     * um quarto da cache. */
+    if (disco.requestQueue != NULL) {
+        return;
+    }
+    for (i = 1; i <= stream->window && disco.prefetchCount < disco.cacheSize / 4; i++) {
+        block = stream->last + i * dir;
+        if (block < 0 || block >= disco.numBlocks) {
+            break;
+        }
+        if (cache_find(block) == NULL && disk_prefetch_find(block, 0) == NULL && !disk_write_pending(block)) {
+            disk_prefetch(block);
+        }
+    }
 }
 
-int disk_block_read(int block, void* buffer) {
+void disk_prefetch(int block) {
     diskrequest_t* request;
 
-    if (sem_down(&(disco.semaforo)) < 0) {
-        return -1;
+    /* O pedido e o buffer ficam num s bloco de memria, liberado por disk_prefetch_done. */
+    request = malloc(sizeof(diskrequest_t) + disco.blockSize);
+    if (request == NULL) {
+        return;
     }
-
-    request = malloc(sizeof(diskrequest_t));
-    request->task = taskExec;
+    request->task = NULL;
     request->operation = DISK_REQUEST_READ;
     request->block = block;
-    request->buffer = buffer;
+    request->count = 1;
+    request->buffer = request + 1;
+    request->done = 0;
+    request->failed = 0;
+    request->arrival = systime();
+    request->batchNext = NULL;
     request->next = NULL;
     request->prev = NULL;
 
-    queue_append((queue_t**)&(disco.requestQueue), (queue_t*)request);
+    queue_append((queue_t**)&(disco.prefetchQueue), (queue_t*)request);
+    disco.prefetchCount++;
+    disco.prefetchIssued++;
 
     if (taskDiskMgr.estado == 's') {
         task_resume(&taskDiskMgr);
     }
+}
 
-    if (sem_up(&(disco.semaforo))) {
-        return -1;
+diskrequest_t* disk_prefetch_find(int block, int promote) {
+    diskrequest_t* request;
+
+    for (request = disco.current; request != NULL; request = request->batchNext) {
+        if (request->task == NULL && request->block == block) {
+            return request;
+        }
     }
 
-    task_suspend(taskExec, &(disco.diskQueue));
-    task_yield();
+    request = disco.prefetchQueue;
+    if (request != NULL) {
+        do {
+            if (request->block == block) {
+                if (promote) {
+                    queue_remove((queue_t**)&(disco.prefetchQueue), (queue_t*)request);
+                    queue_append((queue_t**)&(disco.requestQueue), (queue_t*)request);
+                }
+                return request;
+            }
+            request = request->next;
+        } while (request != disco.prefetchQueue);
+    }
 
-    return 0;
+    /* Leituras antecipadas j promovidas esto na fila de pedidos normais. */
+    request = disco.requestQueue;
+    if (request != NULL) {
+        do {
+            if (request->task == NULL && request->block == block) {
+                return request;
+            }
+            request = request->next;
+        } while (request != disco.requestQueue);
+    }
+    return NULL;
 }
 
-int disk_block_write(int block, void* buffer) {
-    diskrequest_t* request;
+void disk_prefetch_done(diskrequest_t* request) {
+    cacheblock_t* entry;
 
-    if (sem_down(&(disco.semaforo)) < 0) {
-        return -1;
+    /* Como numa leitura normal, o bloco s  guardado se nenhuma escrita mais nova o alterou. */
+    if (!request->failed && cache_find(request->block) == NULL && !disk_write_pending(request->block)) {
+        entry = cache_insert(request->block, request->buffer);
+        if (entry != NULL) {
+            entry->prefetched = 1;
+        }
     }
+    disco.prefetchCount--;
+    free(request);
 
-    request = malloc(sizeof(diskrequest_t));
-    request->task = taskExec;
-    request->operation = DISK_REQUEST_WRITE;
-    request->block = block;
-    request->buffer = buffer;
-    request->next = NULL;
-    request->prev = NULL;
+    while (disco.prefetchWait != NULL) {
+        task_resume(disco.prefetchWait);
+    }
+}
 
-    queue_append((queue_t**)&(disco.requestQueue), (queue_t*)request);
+void disk_readahead_stats(long* issued, long* used) {
+    KERNEL_LOCK();
+    if (issued != NULL) {
+        *issued = disco.prefetchIssued;
+    }
+    if (used != NULL) {
+        *used = disco.prefetchUsed;
+    }
+    KERNEL_UNLOCK();
+}
 
-    if (taskDiskMgr.estado == 's') {
-        task_resume(&taskDiskMgr);
+diskrequest_t* disk_sched_next() {
+    diskrequest_t* request;
+    diskrequest_t* best;
+    diskrequest_t* lowest;
+    int distance;
+    int bestDistance;
+
+    if (disco.sched == DISK_SCHED_FCFS) {
+        return disco.requestQueue;
     }
 
-    if (sem_up(&(disco.semaforo))) {
-        return -1;
+    /* A fila  curta (no mximo um pedido por tarefa), ento  percorrida inteira. Entre pedidos
+     * equivalentes vale o mais antigo, que vem primeiro na fila. */
+    best = NULL;
+    lowest = NULL;
+    bestDistance = 0;
+    request = disco.requestQueue;
+    do {
+        /* Pedidos que esperam um mais antigo aos mesmos blocos ficam de fora; o primeiro da fila
+         * nunca espera, ento sempre h um candidato. */
+        if (!disk_request_blocked(request, disco.requestQueue)) {
+            distance = request->block - disco.head;
+            switch (disco.sched) {
+                case DISK_SCHED_SSTF:
+                    distance = abs(distance);
+                    break;
+                case DISK_SCHED_SCAN:
+                    distance *= disco.direction;
+                    break;
+            }
+            /* S valem pedidos  frente da cabea, exceto no SSTF, em que a distncia  absoluta. */
+            if (distance >= 0 && (best == NULL || distance < bestDistance)) {
+                best = request;
+                bestDistance = distance;
+            }
+            if (lowest == NULL || request->block < lowest->block) {
+                lowest = request;
+            }
+        }
+        request = request->next;
+    } while (request != disco.requestQueue);
+
+    if (best != NULL) {
+        return best;
     }
 
-    task_suspend(taskExec, &(disco.diskQueue));
-    task_yield();
+    /* Nenhum pedido  frente: o C-SCAN volta ao menor bloco e o SCAN inverte o sentido. */
+    if (disco.sched == DISK_SCHED_CSCAN) {
+        return lowest;
+    }
+    disco.direction = -disco.direction;
+    return disk_sched_next();
+}
+
+int disk_request_blocked(diskrequest_t* request, diskrequest_t* queue) {
+    diskrequest_t* older;
 
+    for (older = queue; older != request; older = older->next) {
+        if ((older->operation == DISK_REQUEST_WRITE || request->operation == DISK_REQUEST_WRITE)
+                && older->block < request->block + request->count && request->block < older->block + older->count) {
+            return 1;
+        }
+    }
     return 0;
 }
 
+diskrequest_t* disk_merge(diskrequest_t* request, diskrequest_t** queue, disk_iovec_t* iov, int* iovcnt) {
+    diskrequest_t* first;
+    diskrequest_t* last;
+    diskrequest_t* other;
+    int merged;
+    int n;
+
+    request->batchNext = NULL;
+    first = request;
+    last = request;
+    n = 1;
+
+    /* A cada pedido juntado a sequncia cresce e a fila  percorrida de novo; ela  curta. */
+    do {
+        merged = 0;
+        other = *queue;
+        while (other != NULL && n < DISK_IOV_MAX) {
+            if (other->operation == request->operation && !disk_request_blocked(other, *queue)) {
+                if (other->block == last->block + last->count) {
+                    queue_remove((queue_t**)queue, (queue_t*)other);
+                    last->batchNext = other;
+                    other->batchNext = NULL;
+                    last = other;
+                    merged = 1;
+                }
+                else if (other->block + other->count == first->block) {
+                    queue_remove((queue_t**)queue, (queue_t*)other);
+                    other->batchNext = first;
+                    first = other;
+                    merged = 1;
+                }
+            }
+            if (merged) {
+                n++;
+                break;
+            }
+            other = (other->next != *queue) ? other->next : NULL;
+        }
+    } while (merged && n < DISK_IOV_MAX);
+
+    n = 0;
+    for (other = first; other != NULL; other = other->batchNext) {
+        iov[n].block = other->block;
+        iov[n].count = other->count;
+        iov[n].buffer = other->buffer;
+        n++;
+    }
+    *iovcnt = n;
+    return first;
+}
+
+void disk_complete(int failed) {
+    diskrequest_t* request;
+    diskrequest_t* next;
+
+    /* Acorda as donas dos pedidos concludos (que podem no ser as primeiras da fila, se outra
+     * desistiu por prazo), a menos que elas ainda no tenham voltado a esperar. */
+    for (request = disco.current; request != NULL; request = next) {
+        next = request->batchNext;
+        disco.requests++;
+        disco.latencyTotal += systime() - request->arrival;
+        request->failed = failed;
+        if (request->task == NULL) {
+            disk_prefetch_done(request);
+        }
+        else {
+            request->done = 1;
+            if (request->task->queue == &(disco.diskQueue)) {
+                task_resume(request->task);
+            }
+        }
+    }
+    disco.current = NULL;
+    disco.livre = 1;
+}
+
 void bodyDiskManager(void* arg) {
     diskrequest_t* request;
+    disk_iovec_t iov[DISK_IOV_MAX];
+    int iovcnt;
 
     while (1) {
+        KERNEL_LOCK();
         sem_down(&(disco.semaforo));
         
         if (disco.sinal) {
             disco.sinal = 0;
-            task_resume(disco.diskQueue);
-            disco.livre = 1;
+            disk_complete(0);
         }
 
-        if (disco.livre && disco.requestQueue != NULL) {
-            request = (diskrequest_t*) queue_remove((queue_t**)&(disco.requestQueue), (queue_t*)disco.requestQueue);
-            if (request->operation == DISK_REQUEST_READ) {
-                disk_cmd(DISK_CMD_READ, request->block, request->buffer);
-                disco.livre = 0;
+        if (disco.livre && (disco.requestQueue != NULL || disco.prefetchQueue != NULL)) {
+            /* As leituras antecipadas s usam o disco quando no h pedidos de tarefas. */
+            /* Pedidos vizinhos da mesma fila vo junto, num s comando: a cabea se posiciona uma
+             * vez para a sequncia toda. */
+            if (disco.requestQueue != NULL) {
+                request = disk_sched_next();
+                queue_remove((queue_t**)&(disco.requestQueue), (queue_t*)request);
+                request = disk_merge(request, &(disco.requestQueue), iov, &iovcnt);
             }
-            else if (request->operation == DISK_REQUEST_WRITE) {
-                disk_cmd(DISK_CMD_WRITE, request->block, request->buffer);
+            else {
+                request = disco.prefetchQueue;
+                queue_remove((queue_t**)&(disco.prefetchQueue), (queue_t*)request);
+                request = disk_merge(request, &(disco.prefetchQueue), iov, &iovcnt);
+            }
+            disco.current = request;
+            if (disk_cmd(request->operation == DISK_REQUEST_READ ? DISK_CMD_READV : DISK_CMD_WRITEV, iovcnt, iov) < 0) {
+                /* O disco recusou o comando e no vai sinalizar: o lote termina aqui, com erro. */
+                disk_complete(1);
+            }
+            else {
+                disco.headMovement += abs(request->block - disco.head);
+                disco.head = iov[iovcnt - 1].block + iov[iovcnt - 1].count - 1;
+                disco.commands++;
                 disco.livre = 0;
             }
-            free(request);
         }
 
         sem_up(&(disco.semaforo));
+
+        /* Se no h nada a fazer at o prximo sinal do disco, suspende o gerenciador. Ele 
+         * acordado por disk_block_read/disk_block_write ou pelo dispatcher, ao receber o sinal. */
+        if (!disco.sinal && ((disco.requestQueue == NULL && disco.prefetchQueue == NULL) || !disco.livre)) {
+            task_suspend(NULL, &suspendedQueue);
+        }
         
         task_yield();
+        KERNEL_UNLOCK();
     }
 }
 
@@ -23,6 +23,32 @@ int task_create (task_t *task,			// descritor da nova tarefa
                  void (*start_func)(void *),	// funcao corpo da tarefa
                  void *arg) ;			// argumentos para a tarefa
 
+// Inicializa os atributos de tarefa com os valores padrão
+void task_attr_init (task_attr_t *attr) ;
+
+// Cria uma nova tarefa com os atributos indicados (ou os padrão, se attr for
+// NULL). Uma tarefa desvinculada (detached) pode ser criada com task==NULL, e
+// então o descritor é alocado e liberado pelo núcleo. Retorna um ID> 0 ou erro.
+int task_create_ex (task_t *task,
+                    void (*start_func)(void *),
+                    void *arg,
+                    const task_attr_t *attr) ;
+
+// Cria uma nova tarefa com uma pilha de (pelo menos) stacksize bytes; as
+// pilhas são recicladas por classes de tamanho. Retorna um ID> 0 ou erro.
+int task_create_stack (task_t *task,
+                       void (*start_func)(void *),
+                       void *arg,
+                       int stacksize) ;
+
+// informa quantas pilhas foram reaproveitadas do pool (hits) e quantas
+// precisaram ser alocadas (misses)
+void task_stack_stats (long *hits, long *misses) ;
+
+// retorna o uso máximo (em bytes) da pilha de uma tarefa (ou da tarefa atual),
+// mesmo depois de encerrada; -1 se não disponível (só com STACK_MMAP)
+int task_stack_highwater (task_t *task) ;
+
 // Termina a tarefa corrente, indicando um valor de status encerramento
 void task_exit (int exitCode) ;
 
@@ -32,6 +58,9 @@ int task_switch (task_t *task) ;
 // retorna o identificador da tarefa corrente (main eh 0)
 int task_id () ;
 
+// retorna o nome de uma tarefa (ou da tarefa atual), definido na criação
+const char *task_getname (task_t *task) ;
+
 // suspende uma tarefa, retirando-a de sua fila atual, adicionando-a à fila
 // queue e mudando seu estado para "suspensa"; usa a tarefa atual se task==NULL
 void task_suspend (task_t *task, task_t **queue) ;
@@ -57,10 +86,19 @@ int task_getprio (task_t *task) ;
 // a tarefa corrente aguarda o encerramento de outra task
 int task_join (task_t *task) ;
 
+// As variantes _try nunca bloqueiam e as _timed desistem depois de ms
+// milissegundos; as duas retornam -1 se a operação não pôde ser feita.
+int task_join_try (task_t *task) ;
+int task_join_timed (task_t *task, int ms) ;
+
 // operações de gestão do tempo ================================================
 
-// suspende a tarefa corrente por t segundos
-void task_sleep (int t) ;
+// suspende a tarefa corrente por t segundos; retorna 0, ou -1 se a tarefa não
+// pôde ser posta para dormir (falta de memória) e voltou sem esperar
+int task_sleep (int t) ;
+
+// suspende a tarefa corrente por t milissegundos, retornando como task_sleep
+int task_sleep_ms (int t) ;
 
 // retorna o relógio atual (em milisegundos)
 unsigned int systime () ;
@@ -75,6 +113,10 @@ int sem_create (semaphore_t *s, int value) ;
 // requisita o semáforo
 int sem_down (semaphore_t *s) ;
 
+// requisita o semáforo sem bloquear, ou com prazo de ms milissegundos
+int sem_down_try (semaphore_t *s) ;
+int sem_down_timed (semaphore_t *s, int ms) ;
+
 // libera o semáforo
 int sem_up (semaphore_t *s) ;
 
@@ -86,8 +128,14 @@ int sem_destroy (semaphore_t *s) ;
 // Inicializa um mutex (sempre inicialmente livre)
 int mutex_create (mutex_t *m) ;
 
+// Inicializa um mutex do tipo indicado (MUTEX_NORMAL, MUTEX_RECURSIVE ou
+// MUTEX_ERRORCHECK)
+int mutex_create_type (mutex_t *m, int type) ;
+
 // Solicita um mutex
 int mutex_lock (mutex_t *m) ;
+int mutex_lock_try (mutex_t *m) ;
+int mutex_lock_timed (mutex_t *m, int ms) ;
 
 // Libera um mutex
 int mutex_unlock (mutex_t *m) ;
@@ -95,6 +143,45 @@ int mutex_unlock (mutex_t *m) ;
 // Destrói um mutex
 int mutex_destroy (mutex_t *m) ;
 
+// variáveis de condição
+
+// Inicializa uma variável de condição
+int cond_create (cond_t *c) ;
+
+// Libera o mutex (que deve ser da tarefa corrente) e espera pela condição;
+// retorna com o mutex obtido de novo
+int cond_wait (cond_t *c, mutex_t *m) ;
+
+// Acorda uma das tarefas que esperam pela condição
+int cond_signal (cond_t *c) ;
+
+// Acorda todas as tarefas que esperam pela condição
+int cond_broadcast (cond_t *c) ;
+
+// Destrói a variável de condição, liberando as tarefas bloqueadas
+int cond_destroy (cond_t *c) ;
+
+// travas de leitura/escrita
+
+// Inicializa uma trava de leitura/escrita (inicialmente livre)
+int rwlock_create (rwlock_t *rw) ;
+
+// Solicita a trava para leitura; vários leitores podem tê-la ao mesmo tempo,
+// mas um escritor esperando tem preferência sobre novos leitores. Uma tarefa
+// que já lê a trava pode obtê-la de novo sem esperar (cada leitura pede um
+// rwlock_unlock)
+int rwlock_rdlock (rwlock_t *rw) ;
+
+// Solicita a trava para escrita (exclusiva)
+int rwlock_wrlock (rwlock_t *rw) ;
+
+// Libera a trava obtida com rwlock_rdlock ou rwlock_wrlock; retorna -1 se a
+// tarefa corrente não a detém
+int rwlock_unlock (rwlock_t *rw) ;
+
+// Destrói a trava, liberando as tarefas bloqueadas
+int rwlock_destroy (rwlock_t *rw) ;
+
 // barreiras
 
 // Inicializa uma barreira
@@ -103,6 +190,11 @@ int barrier_create (barrier_t *b, int N) ;
 // Chega a uma barreira
 int barrier_join (barrier_t *b) ;
 
+// Chega a uma barreira só se ela for liberada agora (try), ou esperando no
+// máximo ms milissegundos pela liberação (timed)
+int barrier_join_try (barrier_t *b) ;
+int barrier_join_timed (barrier_t *b, int ms) ;
+
 // Destrói uma barreira
 int barrier_destroy (barrier_t *b) ;
 
@@ -111,12 +203,39 @@ int barrier_destroy (barrier_t *b) ;
 // cria uma fila para até max mensagens de size bytes cada
 int mqueue_create (mqueue_t *queue, int max, int size) ;
 
+// cria uma fila com um único remetente e um único destinatário, que só passa
+// pelo escalonador quando está cheia ou vazia; não aceita a troca sem cópia
+int mqueue_create_spsc (mqueue_t *queue, int max, int size) ;
+
 // envia uma mensagem para a fila
 int mqueue_send (mqueue_t *queue, void *msg) ;
 
 // recebe uma mensagem da fila
 int mqueue_recv (mqueue_t *queue, void *msg) ;
 
+// envio e recebimento sem bloquear, ou com prazo de ms milissegundos
+int mqueue_send_try (mqueue_t *queue, void *msg) ;
+int mqueue_send_timed (mqueue_t *queue, void *msg, int ms) ;
+int mqueue_recv_try (mqueue_t *queue, void *msg) ;
+int mqueue_recv_timed (mqueue_t *queue, void *msg, int ms) ;
+
+// envia as n mensagens do vetor msgs (bloqueando até caberem todas); retorna
+// quantas foram enviadas, menos que n só se a fila for destruída no meio do
+// envio, ou -1 se nenhuma foi
+int mqueue_send_n (mqueue_t *queue, void *msgs, int n) ;
+
+// recebe entre 1 e n mensagens no vetor msgs (bloqueando só se a fila estiver
+// vazia); retorna quantas foram recebidas (0 se n é 0), ou -1 em erro
+int mqueue_recv_n (mqueue_t *queue, void *msgs, int n) ;
+
+// troca sem cópia: mqueue_alloc empresta um slot livre da fila (bloqueando se
+// não houver), que é preenchido e enviado com mqueue_send_buf; mqueue_recv_buf
+// devolve o slot da próxima mensagem, que deve voltar à fila com mqueue_release
+void *mqueue_alloc (mqueue_t *queue) ;
+int mqueue_send_buf (mqueue_t *queue, void *buf) ;
+void *mqueue_recv_buf (mqueue_t *queue) ;
+int mqueue_release (mqueue_t *queue, void *buf) ;
+
 // destroi a fila, liberando as tarefas bloqueadas
 int mqueue_destroy (mqueue_t *queue) ;
 
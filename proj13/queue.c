@@ -123,6 +123,112 @@ queue_t* queue_remove(queue_t** queue, queue_t* elem) {
     return elem;
 }
 
+void queue_append_owned(queue_owned_t** queue, queue_owned_t* elem) {
+    // Se o elemento tem dono, j est em uma fila; aborta.
+    if (elem != NULL && elem->queue != NULL) {
+#ifdef DEBUG
+        printf("Erro queue_append_owned: O elemento ja esta em uma fila.\n");
+#endif
+        return;
+    }
+
+    // A insero  a mesma da fila genrica (que verifica os demais casos).
+    queue_append((queue_t**)queue, (queue_t*)elem);
+
+    // S registra o dono se o elemento foi de fato inserido.
+    if (elem != NULL && elem->next != NULL) {
+        elem->queue = queue;
+    }
+}
+
+void queue_insert_owned(queue_owned_t** queue, queue_owned_t* elem, queue_owned_t* before) {
+    // Sem referncia,  uma insero no final.
+    if (before == NULL) {
+        queue_append_owned(queue, elem);
+        return;
+    }
+
+    // Se o elemento no existe ou j tem dono, aborta.
+    if (elem == NULL || elem->queue != NULL) {
+#ifdef DEBUG
+        printf("Erro queue_insert_owned: O elemento nao existe ou ja esta em uma fila.\n");
+#endif
+        return;
+    }
+
+    // Se a referncia no est nesta fila, aborta.
+    if (queue == NULL || before->queue != queue) {
+#ifdef DEBUG
+        printf("Erro queue_insert_owned: A referencia nao esta na fila indicada.\n");
+#endif
+        return;
+    }
+
+    // Liga o elemento entre a referncia e o anterior a ela; se a referncia era o primeiro,
+    // o elemento passa a ser o incio da fila.
+    elem->prev = before->prev;
+    elem->next = before;
+    before->prev->next = elem;
+    before->prev = elem;
+    elem->queue = queue;
+    if ((*queue) == before) {
+        (*queue) = elem;
+    }
+}
+
+queue_owned_t* queue_remove_owned(queue_owned_t* elem) {
+    queue_owned_t** queue;
+
+    // Se o elemento no existe, aborta.
+    if (elem == NULL) {
+#ifdef DEBUG
+        printf("Erro queue_remove_owned: O elemento nao existe.\n");
+#endif
+        return NULL;
+    }
+
+    // Se o elemento no tem dono, no est em fila alguma.
+    queue = elem->queue;
+    if (queue == NULL || *queue == NULL) {
+#ifdef DEBUG
+        printf("Erro queue_remove_owned: O elemento nao esta em uma fila.\n");
+#endif
+        return NULL;
+    }
+
+#ifdef DEBUG
+    // S na depurao confere se o elemento realmente est na fila registrada.
+    queue_owned_t* iterator = (*queue);
+    while (iterator != elem) {
+        iterator = iterator->next;
+
+        if (iterator == (*queue)) {
+            printf("Erro queue_remove_owned: O elemento nao pertence a fila registrada.\n");
+            return NULL;
+        }
+    }
+#endif
+
+    // Se a fila tem s um elemento, deixa a fila vazia; seno "gruda" os pedaos,
+    // avanando o incio da fila se o elemento for o primeiro.
+    if (elem->next == elem) {
+        (*queue) = NULL;
+    }
+    else {
+        if ((*queue) == elem) {
+            (*queue) = elem->next;
+        }
+        elem->next->prev = elem->prev;
+        elem->prev->next = elem->next;
+    }
+
+    elem->next = NULL;
+    elem->prev = NULL;
+    elem->queue = NULL;
+
+    return elem;
+}
+
 int queue_size(queue_t* queue) {
     int i = 0;
     queue_t* iterator;
@@ -40,6 +40,49 @@ void queue_append (queue_t **queue, queue_t *elem) ;
 
 queue_t *queue_remove (queue_t **queue, queue_t *elem) ;
 
+//------------------------------------------------------------------------------
+// Fila com dono: cada elemento registra em qual fila esta, o que permite
+// remove-lo em tempo constante, sem percorrer a fila. Os tres primeiros campos
+// devem ser prev, next e queue, nesta ordem (como em task_t).
+
+typedef struct queue_owned_t
+{
+   struct queue_owned_t *prev ;    // aponta para o elemento anterior na fila
+   struct queue_owned_t *next ;    // aponta para o elemento seguinte na fila
+   struct queue_owned_t **queue ;  // fila em que o elemento esta, ou NULL
+} queue_owned_t ;
+
+//------------------------------------------------------------------------------
+// Insere um elemento no final da fila e registra a fila no elemento.
+// Condicoes a verificar, gerando msgs de erro:
+// - a fila deve existir
+// - o elemento deve existir
+// - o elemento nao deve estar em outra fila
+
+void queue_append_owned (queue_owned_t **queue, queue_owned_t *elem) ;
+
+//------------------------------------------------------------------------------
+// Insere um elemento na fila imediatamente antes de outro, ou no final se
+// este for NULL, e registra a fila no elemento.
+// Condicoes a verificar, gerando msgs de erro:
+// - a fila deve existir
+// - o elemento deve existir
+// - o elemento nao deve estar em outra fila
+// - o elemento de referencia, se houver, deve estar nesta fila
+
+void queue_insert_owned (queue_owned_t **queue, queue_owned_t *elem, queue_owned_t *before) ;
+
+//------------------------------------------------------------------------------
+// Remove o elemento da fila registrada nele, sem o destruir, em tempo O(1).
+// Condicoes a verificar, gerando msgs de erro:
+// - o elemento deve existir
+// - o elemento deve estar em uma fila
+// - o elemento deve pertencer a fila registrada (so verificado com DEBUG,
+//   pois exige percorrer a fila)
+// Retorno: apontador para o elemento removido, ou NULL se erro
+
+queue_owned_t *queue_remove_owned (queue_owned_t *elem) ;
+
 //------------------------------------------------------------------------------
 // Conta o numero de elementos na fila
 // Retorno: numero de elementos na fila